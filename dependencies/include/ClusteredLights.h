@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <initializer_list>
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <RenderView.h>
+#include <async/JobSystem.h>
+
+// clusters across the screen and along depth, slices are spaced exponentially
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+// indices are stored in 16 bits
+const size_t MAX_POINT_LIGHTS = 4096;
+// lights past this many in one cluster are dropped from it and counted as overflow
+const int MAX_LIGHTS_PER_CLUSTER = 64;
+// first of the three texture units holding lights, clusters and indices; unit 0 is the
+// material array, 1 the depth pyramid
+const int LIGHT_TEXTURE_UNIT = 2;
+// frames averaged per log line, timings change every frame
+const unsigned int LIGHT_REPORT_FRAMES = 300;
+// depth slices assigned per job
+const size_t CLUSTER_SLICES_PER_JOB = 4;
+
+struct PointLight {
+  glm::vec3 position;
+  // the light fades to nothing at this distance
+  float radius;
+  glm::vec3 color;
+};
+
+// What the OBJECT shader reads of one assignment: (offset, count) per cluster, the light
+// indices they point into, two texels per light and the slice mapping. assign() fills it on
+// any thread, upload() hands it to GL, so a frame can be assigned while another is drawn.
+struct LightClusters {
+  std::vector<uint32_t> ranges;
+  std::vector<uint16_t> indices;
+  std::vector<glm::vec4> lightTexels;
+  glm::vec4 parameters;
+};
+
+struct LightStats {
+  unsigned int lights;
+  // lights touching at least one cluster
+  unsigned int visible;
+  // entries over all cluster lists, and the longest list
+  unsigned int references;
+  unsigned int maxPerCluster;
+  unsigned int overflow;
+  double cullMs;
+};
+
+// Clustered forward lighting for many point lights. The view frustum is split into
+// CLUSTER_X * CLUSTER_Y screen tiles times CLUSTER_Z exponential depth slices. Every frame
+// each light's view-space sphere is tested against the boxes of the clusters in the slices
+// it overlaps, one band of slices per job, and the per-cluster lists are
+// compacted into one index list. Lights, cluster ranges and indices go to the OBJECT shader
+// as texture buffers (GL 3.1), so its CLUSTERED_LIGHTS variant only walks the lights of the
+// cluster its fragment falls into instead of every light in the scene.
+class ClusteredLights {
+  public:
+    // defines selecting the OBJECT shader variant, on top of the pass's other defines
+    static std::string shaderDefines();
+
+    ClusteredLights();
+    ~ClusteredLights();
+
+    // false once MAX_POINT_LIGHTS are in
+    bool add(const PointLight &light);
+    // lights may be moved or recolored between updates
+    PointLight &light(size_t i) { return lights[i]; }
+    size_t size() const { return lights.size(); }
+
+    // assigns the lights to the clusters of the view on the calling thread and uploads the
+    // result. Near and far are read from the perspective projection, width and height are
+    // the framebuffer's.
+    void update(const RenderView &view, int width, int height);
+    // the two halves of update(): assign() adds the CPU side to jobs after the given jobs and
+    // returns the one that completes clusters, one assignment at a time; upload() has to
+    // follow it on the GL thread
+    JobId assign(JobSystem &jobs, const RenderView &view, int width, int height, LightClusters &clusters,
+                 std::initializer_list<JobId> after = std::initializer_list<JobId>());
+    void upload(const LightClusters &clusters);
+    // binds the texture buffers and sets the cluster uniforms, shader must be in use
+    void bind(Shader &shader);
+
+    const LightStats &stats() const { return frameStats; }
+    // adds the frame to the running totals and logs their averages every
+    // LIGHT_REPORT_FRAMES frames, call once per frame after update()
+    void report();
+
+  private:
+    // view-space box of one cluster
+    struct ClusterBox {
+      glm::vec3 min;
+      glm::vec3 max;
+    };
+
+    std::vector<PointLight> lights;
+    // per frame: view-space spheres and the slices they overlap
+    std::vector<glm::vec4> viewLights;
+    std::vector<int> firstSlice, lastSlice;
+
+    // rebuilt when the projection changes
+    glm::mat4 projection;
+    float nearPlane, farPlane;
+    std::vector<ClusterBox> boxes;
+
+    // MAX_LIGHTS_PER_CLUSTER slots per cluster, filled by the slice jobs
+    std::vector<uint16_t> clusterLights;
+    std::vector<int> clusterCounts;
+    // the result of update()
+    LightClusters clusters;
+
+    // light, range and index buffers and the buffer textures over them
+    unsigned int buffers[3];
+    unsigned int textures[3];
+    // of the last upload(), for bind()
+    glm::vec4 clusterParameters;
+    // threads the last assignment could spread over and when it started
+    unsigned int assignThreads;
+    std::chrono::steady_clock::time_point assignStart;
+
+    LightStats frameStats;
+    LightStats totalStats;
+    unsigned int totalFrames;
+
+
+    void buildBoxes(const glm::mat4 &projection);
+    // view-space spheres of the lights and the slices they overlap
+    void prepare(const RenderView &view, int width, int height, LightClusters &clusters);
+    // lights into the clusters of slices [first, last)
+    void assignSlices(int first, int last);
+    // packs the cluster lists and the light texels into clusters
+    void compact(LightClusters &clusters);
+    void uploadBuffer(int buffer, GLenum format, const void *data, size_t bytes);
+
+    ClusteredLights(const ClusteredLights &);
+    ClusteredLights &operator=(const ClusteredLights &);
+};
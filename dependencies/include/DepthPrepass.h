@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <glad/glad.h>
+
+// timer queries in flight, results are read this many frames late so nothing waits on the GPU
+const unsigned int DEPTH_PREPASS_QUERIES = 4;
+// frames averaged per log line, timings change every frame
+const unsigned int DEPTH_PREPASS_REPORT_FRAMES = 300;
+
+// Optional depth pre-pass for the opaque scene. When enabled the scene is drawn twice: first
+// with the OBJECT shader's DEPTH_ONLY variant from the position-only mesh streams and color
+// writes off, then shaded with depth writes off and GL_EQUAL, so the lighting fragment shader
+// runs about once per pixel instead of once per overlapping fragment. The scene's GPU time
+// is measured with timer queries either way, so toggling it at runtime shows what the extra
+// geometry pass costs against the shading it saves.
+class DepthPrepass {
+  public:
+    // defines selecting the depth-only OBJECT variant, on top of the pass's other defines
+    static std::string shaderDefines();
+
+    explicit DepthPrepass(bool enabled = false);
+    ~DepthPrepass();
+
+    bool enabled() const { return on; }
+    // takes effect at the next begin() and restarts the averages
+    void setEnabled(bool enabled);
+
+    // starts timing the scene; when enabled, draws until beginShading() only write depth
+    void begin();
+    // when enabled, color is written again and depth only tested for equality from here
+    void beginShading();
+    // restores depth writes and GL_LESS, stops the timer
+    void end();
+
+  private:
+    unsigned int queries[DEPTH_PREPASS_QUERIES];
+    bool pending[DEPTH_PREPASS_QUERIES];
+    unsigned int frame;
+    bool on;
+
+    double totalMs;
+    unsigned int totalFrames;
+
+    // adds the oldest query's result to the totals if the GPU has it by now
+    void collect(unsigned int query);
+    void report();
+
+    DepthPrepass(const DepthPrepass &);
+    DepthPrepass &operator=(const DepthPrepass &);
+};
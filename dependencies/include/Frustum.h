@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+enum FrustumTest {
+  FRUSTUM_OUTSIDE,
+  FRUSTUM_INTERSECTS,
+  FRUSTUM_INSIDE
+};
+
+// The six clip planes of a view, normals pointing inwards and normalized so plane distances are
+// world units: a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+struct Frustum {
+  glm::vec4 planes[6];
+
+  // extracts the planes from projection * view (Gribb/Hartmann)
+  static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+  bool intersectsSphere(const glm::vec3 &center, float radius) const;
+  FrustumTest testBox(const glm::vec3 &min, const glm::vec3 &max) const;
+  // tests count spheres stored as separate x/y/z/radius arrays four at a time, visible[i] is
+  // set to 1 or 0
+  void testSpheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible) const;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <assets/MeshAsset.h>
+#include <mesh/VertexFormat.h>
+
+class RenderObject;
+
+// Where a mesh landed in the arena. Indices stay relative to the mesh, draws add baseVertex.
+struct ArenaRange {
+  GLint baseVertex;
+  // in arena indices, a LOD starts at firstIndex + lod.indexOffset
+  GLuint firstIndex;
+};
+
+// One vertex buffer, one index buffer and one VAO holding every static mesh of a scene, so
+// drawing any of them needs no VAO or buffer rebind. The meshes are copied GPU side from
+// their own buffers, which stay valid for the regular draw path.
+class GeometryArena {
+  public:
+    unsigned int VAO, VBO, EBO;
+    // the meshes' position-only streams in the same vertex order, sharing EBO
+    unsigned int depthVAO, positionVBO;
+    VertexFormat format;
+    // 32-bit as soon as one mesh needs it, 16-bit meshes are widened on the way in
+    GLenum indexType;
+
+    GeometryArena();
+    ~GeometryArena();
+
+    // GL thread only, after the meshes were uploaded. False if the objects use more than one
+    // vertex format or none of them is ready.
+    bool build(const std::vector<RenderObject*> &objects);
+
+    bool contains(const MeshAsset &mesh) const { return ranges.count(&mesh) != 0; }
+    const ArenaRange &range(const MeshAsset &mesh) const { return ranges.find(&mesh)->second; }
+    size_t indexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int); }
+
+  private:
+    std::map<const MeshAsset*, ArenaRange> ranges;
+    // keeps the keys of ranges alive
+    std::vector<std::shared_ptr<MeshAsset> > meshes;
+
+    GeometryArena(const GeometryArena &);
+    GeometryArena &operator=(const GeometryArena &);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <RenderView.h>
+#include <GeometryArena.h>
+#include <IndirectQueue.h>
+#include <InstanceBuffer.h>
+#include <mesh/Mesh.h>
+
+class RenderObject;
+
+// frames between two readbacks of the surviving instance count, each one waits for the GPU
+const unsigned int GPU_CULL_REPORT_FRAMES = 300;
+// texture unit of the depth pyramid, unit 0 holds the material array
+const int PYRAMID_TEXTURE_UNIT = 1;
+
+// GL 4.3 path that keeps culling and draw setup on the GPU. build() uploads every instance of
+// a set of arena objects, with its world-space bounds and the index of its object's command;
+// refit() replaces those of objects that moved since. Each frame a compute shader tests all instances against the frustum and against a
+// max-depth pyramid of the previous frame, and appends the survivors to their command's
+// range of a compacted instance buffer while counting them into the command's instanceCount.
+// One glMultiDrawElementsIndirect then draws the lot, so the CPU cost does not depend on the
+// instance count. Objects always use LOD 0 here. Needs the INDIRECT_DRAW shader variant, like
+// IndirectQueue, and the context to report 4.3 or newer.
+class GpuCuller {
+  public:
+    GpuCuller(GeometryArena &arena);
+    ~GpuCuller();
+
+    // looks up the 4.3 entry points the glad loader does not cover and builds the compute
+    // programs. False keeps the CPU culling path.
+    bool init(GLADloadproc load);
+    // GL thread only, every object has to be in the arena and in a MaterialBatch
+    bool build(const std::vector<RenderObject*> &objects);
+    bool ready() const { return instanceCount > 0; }
+    // GL thread only: rewrites the instances and bounds of the built non-instanced entities at
+    // indices with their new world matrices, transforms[i] belonging to indices[i]
+    void refit(const std::vector<uint32_t> &indices, const std::vector<InstanceTransform> &transforms);
+
+    // fills the frame's commands with the instances that survive the view
+    void cull(const RenderView &view);
+    // draws the survivors' positions only with the DEPTH_ONLY variant, see DepthPrepass
+    void drawDepth(Shader &shader);
+    // draws the survivors, the material batch must already be bound to shader
+    void draw(Shader &shader);
+    // copies the depth buffer of the frame just drawn and reduces it into the pyramid the
+    // next draw() tests against
+    void captureDepth(int width, int height);
+
+  private:
+    // std430 element of the instance buffers, the draw index is padded to a vec4
+    struct Instance {
+      InstanceTransform transform;
+      int32_t draw[4];
+    };
+    // std430 world bounds of an instance
+    struct Bounds {
+      glm::vec4 sphere;
+      glm::vec4 min;
+      glm::vec4 max;
+    };
+
+    typedef void (APIENTRY *DispatchComputeProc)(GLuint x, GLuint y, GLuint z);
+    typedef void (APIENTRY *MemoryBarrierProc)(GLbitfield barriers);
+    typedef void (APIENTRY *BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+    typedef void (APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+
+    GeometryArena &arena;
+    std::unique_ptr<Shader> cullShader;
+    std::unique_ptr<Shader> reduceShader;
+    DispatchComputeProc dispatchCompute;
+    MemoryBarrierProc memoryBarrier;
+    BindImageTextureProc bindImageTexture;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+
+    unsigned int instanceCount;
+    unsigned int drawCount;
+    // instances and their bounds as built, the per-frame survivors, the commands with zero
+    // instances to reset from, the commands the draw reads, the Draws block
+    unsigned int instanceBuffer, boundsBuffer, visibleBuffer, commandTemplate, commandBuffer, drawBuffer;
+
+    // depth of the last frame and its max reduction, level 0 is half its size
+    unsigned int depthTexture, pyramidTexture;
+    int depthWidth, depthHeight;
+    int pyramidWidth, pyramidHeight, pyramidLevels;
+    // camera of the frame being drawn and of the one the pyramid was captured from
+    glm::mat4 frameViewProjection, pyramidViewProjection;
+    bool pyramidValid;
+
+    // by entity index, the draw of each non-instanced entity built, -1 for the others
+    std::vector<int32_t> entityDraws;
+    // object-space bounds and single instance of those draws, by draw
+    std::vector<MeshBounds> drawBounds;
+    std::vector<uint32_t> drawInstances;
+
+    unsigned int frames;
+
+    // issues the frame's commands from vao, the arena's full or position-only VAO
+    void drawCommands(Shader &shader, unsigned int vao);
+    void resizeDepth(int width, int height);
+    void report();
+
+    GpuCuller(const GpuCuller &);
+    GpuCuller &operator=(const GpuCuller &);
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <RenderView.h>
+#include <GeometryArena.h>
+#include <InstanceBuffer.h>
+
+class RenderObject;
+class SceneWorld;
+
+// draws one frame can hold, MAX_INDIRECT_DRAWS is baked into the shader
+const int MAX_INDIRECT_DRAWS = 256;
+// vertex attribute holding the instance's draw, after the model matrix (INSTANCE_ATTRIBUTE + 0..3)
+const GLuint DRAW_ATTRIBUTE = 7;
+
+// layout GL reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// std140 entry of the OBJECT shader's Draws block
+struct DrawData {
+  float positionOffset[4];
+  float positionScale[4];
+  int32_t material[4];
+};
+// quantization and batched material of the entity's mesh
+DrawData makeDrawData(const SceneWorld &world, uint32_t index);
+
+struct IndirectQueueStats {
+  unsigned int draws;
+  unsigned int instances;
+  // GL draw calls issued, 1 with glMultiDrawElementsIndirect (2 with a depth pre-pass)
+  unsigned int calls;
+};
+
+// Draws objects whose meshes live in a GeometryArena and whose materials are in a
+// MaterialBatch with as few calls as the context allows. Every submitted object becomes one
+// indirect command; its instances are appended to a per-frame instance stream together with
+// the index of their command, which the shader uses to fetch the draw's quantization and
+// material from the Draws block. On GL 4.3 the whole frame is one glMultiDrawElementsIndirect,
+// older contexts (3.3, macOS) replay the commands with glDrawElementsInstancedBaseVertex
+// from the same VAO. Needs the OBJECT shader variant built with shaderDefines().
+class IndirectQueue {
+  public:
+    // defines selecting the OBJECT shader variant, on top of MaterialBatch::shaderDefines()
+    static std::string shaderDefines();
+
+    IndirectQueue(GeometryArena &arena);
+    ~IndirectQueue();
+
+    // looks up glMultiDrawElementsIndirect when the context is 4.3 or newer, the glad
+    // loader only covers 3.3. Returns whether the single-call path is available.
+    bool loadMultiDraw(GLADloadproc load);
+    bool multiDraw() const { return multiDrawElementsIndirect != NULL; }
+
+    void begin(const RenderView &view);
+    // false if the entity cannot take this path (mesh outside the arena, material not
+    // batched, frame full), draw it through RenderQueue instead. subset limits the draw to
+    // those instance indices, see SceneCuller.
+    bool submit(SceneWorld &world, uint32_t index, const std::vector<uint32_t> *subset = NULL);
+    bool submit(RenderObject &object, const std::vector<uint32_t> *subset = NULL);
+    // draws the frame's positions only with the DEPTH_ONLY variant, before flush(), see
+    // DepthPrepass
+    void flushDepth(Shader &shader);
+    // uploads the frame and draws it, the material batch must already be bound to shader
+    void flush(Shader &shader);
+
+    const IndirectQueueStats &stats() const { return frameStats; }
+
+  private:
+    // one element of the instance stream
+    struct Instance {
+      InstanceTransform transform;
+      int32_t draw;
+    };
+
+    typedef void (APIENTRY *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+
+    GeometryArena &arena;
+    RenderView view;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> draws;
+    std::vector<Instance> instances;
+    unsigned int commandBuffer, drawBuffer, instanceBuffer;
+    // the frame's buffers were written by flushDepth
+    bool uploaded;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+    IndirectQueueStats frameStats;
+    IndirectQueueStats reportedStats;
+
+    // points the instance attributes of the arena VAO at the stream, starting at first
+    void pointInstances(size_t first);
+    void upload();
+    // issues the commands from vao, the arena's full or position-only VAO
+    void drawCommands(unsigned int vao);
+    void report();
+
+    IndirectQueue(const IndirectQueue &);
+    IndirectQueue &operator=(const IndirectQueue &);
+};
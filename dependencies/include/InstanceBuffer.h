@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// first of the four vec4 attribute locations holding the per-instance model matrix
+const GLuint INSTANCE_ATTRIBUTE = 3;
+// first of the three vec3 locations holding its normal matrix, after IndirectQueue's draw index
+const GLuint NORMAL_ATTRIBUTE = 8;
+
+// inverse transpose of the model's upper 3x3, what normals are transformed with
+glm::mat3 normalMatrix(const glm::mat4 &model);
+
+// What the OBJECT shader reads per instance: the model matrix and the normal matrix worked
+// out once when the transform is set, instead of inverting the model for every vertex. The
+// normal matrix columns are padded to vec4, so this is also a valid std430 array element.
+struct InstanceTransform {
+  glm::mat4 model;
+  glm::vec4 normal[3];
+
+  InstanceTransform() {}
+  explicit InstanceTransform(const glm::mat4 &model);
+  InstanceTransform(const glm::mat4 &model, const glm::mat3 &normal);
+};
+
+// Model matrices of every copy of an object, drawn with one glDrawElementsInstanced. Edits
+// only change the CPU copy and widen a dirty range, the next bind() uploads that range with
+// a single glBufferSubData. Objects making up the same thing (the pieces of an island)
+// can share one list.
+class InstanceBuffer {
+  public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    // returns the index of the new instance
+    size_t add(const glm::mat4 &transform);
+    void set(size_t index, const glm::mat4 &transform);
+    // moves the last instance into index to keep the list packed
+    void remove(size_t index);
+    void clear();
+
+    const glm::mat4 &get(size_t index) const { return transforms[index].model; }
+    size_t size() const { return transforms.size(); }
+    bool empty() const { return transforms.empty(); }
+
+    // GL thread only. Uploads pending edits and points the instance attributes of the bound
+    // VAO at the buffer.
+    void bind();
+    // gives every vertex of the bound VAO the same transform, for objects drawn once
+    static void bindConstant(const glm::mat4 &transform, const glm::mat3 &normal);
+    // points the model and normal attributes of the bound VAO at InstanceTransforms in the
+    // bound GL_ARRAY_BUFFER, stride bytes apart starting at offset
+    static void pointAttributes(GLsizei stride, size_t offset);
+
+  private:
+    std::vector<InstanceTransform> transforms;
+    unsigned int buffer;
+    // instances the GL buffer has room for
+    size_t capacity;
+    // [dirtyBegin, dirtyEnd) changed since the last upload
+    size_t dirtyBegin, dirtyEnd;
+
+    void markDirty(size_t begin, size_t end);
+    void upload();
+
+    InstanceBuffer(const InstanceBuffer &);
+    InstanceBuffer &operator=(const InstanceBuffer &);
+};
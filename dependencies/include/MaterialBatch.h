@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+#include <shaders/shader.h>
+
+class RenderObject;
+
+// materials and albedo layers one batch can hold, MAX_MATERIALS is baked into the shader
+const int MAX_MATERIALS = 64;
+const int MAX_LAYER_SIZE = 1024;
+const int MIN_LAYER_SIZE = 64;
+// texture unit of the albedo array
+const int MATERIAL_TEXTURE_UNIT = 0;
+
+// Packs the albedo maps of a set of objects into one GL_TEXTURE_2D_ARRAY (resampled to a
+// common square size) and their specular/shininess into one uniform buffer. Objects in the
+// batch then only set materialIndex per draw; the texture and the buffer are bound once per
+// frame. Needs the OBJECT shader variant built with shaderDefines().
+class MaterialBatch {
+  public:
+    unsigned int textureArray;
+    unsigned int materialBuffer;
+    int layerSize;
+    int layerCount;
+    int materialCount;
+
+    // defines selecting the OBJECT shader variant that reads from the batch
+    static std::string shaderDefines();
+
+    MaterialBatch();
+    ~MaterialBatch();
+
+    // GL thread only, after the objects' textures were requested. Decodes every distinct
+    // albedo map once, assigns each object its materialIndex and drops its own texture.
+    bool build(const std::vector<RenderObject*> &objects);
+    // binds the array and the buffer and points shader at them
+    void bind(Shader &shader);
+
+  private:
+    MaterialBatch(const MaterialBatch &);
+    MaterialBatch &operator=(const MaterialBatch &);
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <glm/glm.hpp>
+#include <RenderView.h>
+#include <mesh/Mesh.h>
+#include <async/JobSystem.h>
+
+class RenderObject;
+
+// resolution of the software depth buffer, the width has to be a multiple of 4
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 192;
+// pixels per side of a hierarchical depth tile, also the row granularity of the raster jobs
+const int OCCLUSION_TILE = 8;
+// each occluder instance is drawn at its coarsest LOD whose simplification error projects to
+// at most this fraction of a depth buffer pixel, so it hides nothing the full mesh would not
+const float OCCLUDER_PIXEL_ERROR = 0.25f;
+// frames averaged per log line, timings change every frame
+const unsigned int OCCLUSION_REPORT_FRAMES = 300;
+
+struct OcclusionStats {
+  unsigned int occluderTriangles;
+  // triangles left after near-plane, back-face and screen rejection
+  unsigned int rasterizedTriangles;
+  unsigned int tested;
+  unsigned int occluded;
+  double rasterMs;
+  double testMs;
+};
+
+// Software occlusion culling. Selected occluders (terrain, large rocks) are rasterized at low
+// resolution into a depth buffer on the CPU, four pixels at a time with SSE2/NEON and split
+// into bands of tile rows across jobs. Each band then keeps the farthest depth of
+// every OCCLUSION_TILE square, so a box test first compares its nearest depth against those
+// tiles and only looks at single pixels where a tile is inconclusive. Occluders are only
+// simplified as far as stays below a pixel of the buffer, and drawn where they cover a pixel
+// center, so culling can only be off by part of a pixel at silhouettes.
+class OcclusionCuller {
+  public:
+    OcclusionCuller();
+
+    // GL thread only, reads the positions and the indices of every LOD of the object's mesh
+    // back from its buffers. The object's transform or instances are read at every render().
+    bool addOccluder(const RenderObject &object);
+
+    // adds jobs rasterizing every occluder instance from the view after the given jobs and
+    // returns the one that finishes the depth buffer, starts a new set of stats
+    JobId render(JobSystem &jobs, const RenderView &view, std::initializer_list<JobId> after = std::initializer_list<JobId>());
+    // false if the world-space box is hidden behind the occluders drawn by render()
+    bool testBox(const glm::vec3 &min, const glm::vec3 &max);
+
+    const OcclusionStats &stats() const { return frameStats; }
+    // adds the frame to the running totals and logs their averages every
+    // OCCLUSION_REPORT_FRAMES frames, call once per frame after the tests
+    void report();
+
+  private:
+    struct Occluder {
+      const RenderObject *object;
+      MeshBounds bounds;
+      std::vector<glm::vec3> positions;
+      // triangles and object-space error of each LOD, finest first
+      std::vector<std::vector<uint32_t> > indices;
+      std::vector<float> errors;
+    };
+    // screen-space triangle set up for the edge-function raster
+    struct Triangle {
+      // edge i covers pixel centers with edgeA[i] * x + edgeB[i] * y + edgeC[i] >= 0
+      float edgeA[3], edgeB[3], edgeC[3];
+      // depth plane: z = z0 + x * dzdx + y * dzdy
+      float z0, dzdx, dzdy;
+      int minX, maxX, minY, maxY;
+    };
+
+    std::vector<Occluder> occluders;
+    glm::mat4 viewProjection;
+    std::vector<float> depth;
+    // farthest depth of each tile
+    std::vector<float> tileDepth;
+    std::vector<glm::vec4> clip;
+    std::vector<Triangle> triangles;
+    // threads the last render() could spread over and when it started
+    unsigned int rasterThreads;
+    std::chrono::steady_clock::time_point rasterStart;
+
+    OcclusionStats frameStats;
+    OcclusionStats totalStats;
+    unsigned int totalFrames;
+
+    // the screen-space triangles of every occluder instance
+    void setup(const RenderView &view);
+    // coarsest level of the occluder that stays within OCCLUDER_PIXEL_ERROR at model
+    size_t selectLod(const Occluder &occluder, const glm::mat4 &model, const RenderView &view) const;
+    void setupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    // draws the triangles into rows [firstRow, lastRow) and updates their tiles
+    void rasterizeBand(int firstRow, int lastRow);
+
+    OcclusionCuller(const OcclusionCuller &);
+    OcclusionCuller &operator=(const OcclusionCuller &);
+};
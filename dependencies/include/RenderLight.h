@@ -1,23 +1,27 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <shaders/shader.h>
+#include <assets/MeshAsset.h>
+
+class AssetLoader;
 
 class RenderLight {
   public:
-    unsigned int VAO, VBO;
-    std::vector<float> vertices;
+    std::shared_ptr<MeshAsset> mesh;
     glm::vec3 lightPos;
     
     RenderLight(const std::string &modelPath);
+    RenderLight(const std::string &modelPath, AssetLoader &loader);
     void renderLight(Shader &shader);
-    void renderSun(glm::mat4 &projection, glm::mat4 &view, Shader &lightCubeShader);
-    
+    // the sun model at position, the light of the frame being drawn
+    void renderSun(Shader &lightShader, const glm::vec3 &position);
+
   private:
-    void setupMesh();
-    std::vector<float> loadObjModel(const std::string& path);
+    void draw();
 };
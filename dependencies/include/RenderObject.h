@@ -1,25 +1,77 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <string>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <shaders/shader.h>
+#include <RenderView.h>
+#include <SceneWorld.h>
+#include <InstanceBuffer.h>
+#include <assets/MeshAsset.h>
+#include <assets/TextureAsset.h>
+#include <mesh/VertexFormat.h>
 
+class AssetLoader;
+
+// One entity of a SceneWorld seen as an object. The components live in the world's packed
+// arrays, the accessors return references into them that stay valid until the world
+// creates or destroys an entity. Destroying the object destroys its entity.
 class RenderObject {
   public:
-    unsigned int VAO, VBO;
-    std::vector<float> vertices;
-    unsigned int texture;
-    glm::vec3 specular;
-    float shininess;
+    // GPU layout used by objects constructed after it is set
+    static VertexFormat vertexFormat;
     
-    RenderObject(const std::string &modelPath, const std::string &texturePath, glm::vec3 specular, float shininess);
+    RenderObject(SceneWorld &world, const std::string &modelPath, const std::string &texturePath, glm::vec3 specular, float shininess);
+    // takes the assets from the loader's registry, the object draws nothing until loader.finish()/poll() uploads them
+    RenderObject(SceneWorld &world, const std::string &modelPath, const std::string &texturePath, glm::vec3 specular, float shininess, AssetLoader &loader);
+    ~RenderObject();
+
+    SceneWorld &world() const { return *owner; }
+    Entity entity() const { return handle; }
+    uint32_t index() const { return owner->index(handle); }
+
+    // shared with every other object loading the same files
+    std::shared_ptr<MeshAsset> &mesh() const { return owner->meshes[index()]; }
+    std::shared_ptr<TextureAsset> &texture() const { return owner->materials[index()].texture; }
+    glm::vec3 &specular() const { return owner->materials[index()].specular; }
+    float &shininess() const { return owner->materials[index()].shininess; }
+    // entry in a MaterialBatch, -1 draws with its own texture and material uniforms
+    int &materialIndex() const { return owner->materials[index()].batchIndex; }
+    // model matrix when drawn once, as of the world's last updateTransforms()
+    const glm::mat4 &transform() const { return owner->transforms[index()]; }
+    const glm::mat3 &normalMatrix() const { return owner->normalMatrices[index()]; }
+    // relative to the parent, takes effect with the world's next updateTransforms()
+    void setTransform(const glm::mat4 &local) { owner->setTransform(index(), local); }
+    // NULL detaches the object, false if parent hangs below it
+    bool setParent(const RenderObject *parent) { return owner->setParent(handle, parent ? parent->handle : NO_ENTITY); }
+    // set to draw one copy per entry with a single instanced draw, transform is then unused
+    std::shared_ptr<InstanceBuffer> &instances() const { return owner->instances[index()]; }
+
+    bool ready() const { return owner->ready(index()); }
+    // draws LOD 0
     void render(Shader &shader);
+    // draws the level picked from the projected simplification error, see selectLod
+    void render(Shader &shader, const RenderView &view);
+    unsigned int selectLod(const RenderView &view) { return owner->selectLod(index(), view); }
+
+    // the pieces of a draw, so RenderQueue can skip the state that did not change
+    void bindMaterial(Shader &shader) { owner->bindMaterial(index(), shader); }
+    // positionsOnly binds the mesh's position stream for a DEPTH_ONLY shader
+    void bindMesh(Shader &shader, bool positionsOnly = false) { owner->bindMesh(index(), shader, positionsOnly); }
+    void drawLod(const MeshLod &lod) { owner->drawLod(index(), lod); }
+    // copies drawn by drawLod
+    unsigned int instanceCount() const { return owner->instanceCount(index()); }
     void renderSun(const glm::mat4 &projection, const glm::mat4 &view, GLuint sunVAO, const std::vector<float> &sun, Shader &lightCubeShader);
     
   private:
-    void setupMesh();
-    unsigned int loadTexture(const char *path);
-    std::vector<float> loadObjModel(const std::string& path);
+    SceneWorld *owner;
+    Entity handle;
+
+    void draw(Shader &shader, const MeshLod &lod);
+
+    // one handle per entity, a copy would destroy it twice
+    RenderObject(const RenderObject &);
+    RenderObject &operator=(const RenderObject &);
 };
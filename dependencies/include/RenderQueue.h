@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <RenderView.h>
+
+class RenderObject;
+class SceneWorld;
+
+enum RenderPass {
+  PASS_OPAQUE,
+  PASS_TRANSPARENT
+};
+
+// Sort key, most significant first: pass (4 bits), shader (8), material (20), depth (32).
+// Opaque depth sorts front-to-back, transparent depth back-to-front.
+uint64_t makeSortKey(RenderPass pass, unsigned int shader, unsigned int material, float depth);
+// LSD radix sort of keys, order receives the sorted item indices
+void radixSort(const std::vector<uint64_t> &keys, std::vector<uint32_t> &order);
+
+struct RenderQueueStats {
+  unsigned int draws;
+  // copies drawn, more than draws when objects are instanced
+  unsigned int instances;
+  // state changes issued in sorted order ...
+  unsigned int shaderChanges, materialChanges, meshChanges;
+  // ... and the ones the submission order would have issued
+  unsigned int unsortedShaderChanges, unsortedMaterialChanges, unsortedMeshChanges;
+  // opaque draws repeated by flushDepth
+  unsigned int depthDraws;
+};
+
+// Collects the frame's draws instead of issuing them immediately, sorts them by key and
+// only rebinds shader, material and mesh when they differ from the previous draw.
+class RenderQueue {
+  public:
+    RenderQueue();
+
+    // starts a frame, the shaders' per-frame uniforms must already be set
+    void begin(const RenderView &view);
+    // picks the entity's LOD and queues it with its current matrices, entities still loading
+    // are skipped. The world may move entities before flush(), but must not create or
+    // destroy any.
+    void submit(SceneWorld &world, uint32_t index, Shader &shader, RenderPass pass = PASS_OPAQUE);
+    void submit(RenderObject &object, Shader &shader, RenderPass pass = PASS_OPAQUE);
+    // sorts the items by key. flush() and flushDepth() sort when nobody did, calling it
+    // first lets the sort run off the GL thread.
+    void sort();
+    // draws the opaque items' positions only with a DEPTH_ONLY shader, before flush(), see
+    // DepthPrepass. Uses the LODs and order flush() will use, so both passes match.
+    void flushDepth(Shader &shader);
+    // sorts and draws everything submitted since begin()
+    void flush();
+
+    const RenderQueueStats &stats() const { return frameStats; }
+
+  private:
+    struct Item {
+      SceneWorld *world;
+      uint32_t index;
+      Shader *shader;
+      RenderPass pass;
+      unsigned int lod;
+      // world and normal matrix at submit(), unused for instanced entities
+      glm::mat4 transform;
+      glm::mat3 normalMatrix;
+    };
+
+    RenderView view;
+    std::vector<Item> items;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    bool sorted;
+    RenderQueueStats frameStats;
+    RenderQueueStats reportedStats;
+
+    void report();
+    static bool sameMaterial(const Item &a, const Item &b);
+    static bool sameMesh(const Item &a, const Item &b);
+    static void draw(const Item &item);
+};
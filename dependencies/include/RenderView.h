@@ -0,0 +1,14 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Camera state of the frame being drawn, shared by everything that needs more than the shader uniforms.
+struct RenderView {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 position;
+  float viewportHeight;
+
+  // pixels covered by one object-space unit at distance 1
+  float pixelsPerUnit() const { return projection[1][1] * viewportHeight * 0.5f; }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <Frustum.h>
+#include <RenderView.h>
+#include <mesh/Mesh.h>
+
+class SceneWorld;
+class OcclusionCuller;
+
+// below this many bounds a flat SIMD pass beats walking the tree
+const size_t BVH_MIN_ITEMS = 64;
+// bounds per BVH leaf, tested together by Frustum::testSpheres
+const size_t BVH_LEAF_SIZE = 8;
+
+// world-space sphere and box of one instance of a mesh
+struct WorldBounds {
+  glm::vec3 center;
+  float radius;
+  glm::vec3 min, max;
+};
+WorldBounds transformBounds(const MeshBounds &bounds, const glm::mat4 &model);
+
+struct CullStats {
+  unsigned int tested;
+  unsigned int visible;
+  unsigned int culled;
+  // of the culled, those inside the frustum but hidden behind occluders
+  unsigned int occluded;
+  // BVH nodes whose box was tested, 0 for the flat pass
+  unsigned int nodes;
+};
+
+// Frustum culling of every instance of a SceneWorld's entities. build() transforms each
+// mesh's bounds by the entity's instances, or its world matrix, once, then cull() decides per
+// frame which instances touch the view frustum: small scenes test all bounding spheres in one
+// SIMD pass, larger ones go through a BVH of world-space boxes where subtrees entirely inside
+// the frustum skip their tests. refit() follows entities whose transforms changed, moving
+// their bounds and growing or shrinking the boxes above them without reordering the tree;
+// call build() again after instance lists change. With an OcclusionCuller set, the boxes that survive the frustum are
+// tested against its depth buffer. Results are by entity index, so the camera pass submits
+// straight from the world's arrays.
+class SceneCuller {
+  public:
+    // label starts the report lines, to tell the culler of each pass apart
+    explicit SceneCuller(const char *label = "CULL");
+
+    // entities still loading are never culled. The world must not create or destroy
+    // entities until the next build().
+    void build(const SceneWorld &world);
+    // moves the bounds of the non-instanced entities at indices to their current world
+    // matrices, typically SceneWorld::movedIndices() right after updateTransforms()
+    void refit(const SceneWorld &world, const std::vector<uint32_t> &indices);
+    // the occlusion buffer has to be rendered for the same view before cull()
+    void setOcclusion(OcclusionCuller *occlusion) { this->occlusion = occlusion; }
+    void cull(const RenderView &view);
+
+    // whether anything of the entity at index passed the last cull()
+    bool visible(uint32_t index) const;
+    // instance indices of the entity that passed, NULL if it is not culled at all
+    const std::vector<uint32_t> *visibleInstances(uint32_t index) const;
+
+    const CullStats &stats() const { return frameStats; }
+
+  private:
+    struct Node {
+      glm::vec3 min, max;
+      // items [first, first + count) in BVH order
+      uint32_t first, count;
+      // children at left and left + 1, 0 for leaves
+      uint32_t left;
+    };
+
+    // bounds in BVH order as separate arrays for the SIMD test
+    std::vector<float> x, y, z, radius;
+    std::vector<glm::vec3> boxMin, boxMax;
+    // entity index and instance of each item
+    std::vector<uint32_t> itemEntity, itemInstance;
+    std::vector<Node> nodes;
+    std::vector<uint8_t> itemVisible;
+    OcclusionCuller *occlusion;
+    const char *label;
+
+    // item permutation while the tree is built
+    std::vector<uint32_t> order;
+    // entities refit() was given, by entity index
+    std::vector<uint8_t> refitting;
+
+    std::vector<bool> culled;
+    std::vector<std::vector<uint32_t> > instances;
+    CullStats frameStats;
+    CullStats reportedStats;
+
+    void buildTree();
+    // fills in the bounds of nodes[node] and splits it until the leaves are small enough
+    void buildNode(uint32_t node);
+    // bounds of every node again from its items or children, bottom up
+    void refitTree();
+    void cullNode(const Frustum &frustum, uint32_t node);
+    void report();
+};
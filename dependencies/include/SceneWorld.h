@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <Frustum.h>
+#include <RenderView.h>
+#include <RenderQueue.h>
+#include <InstanceBuffer.h>
+#include <assets/MeshAsset.h>
+#include <assets/TextureAsset.h>
+
+// handle of an entity, stays the same while other entities come and go
+typedef uint32_t Entity;
+const Entity NO_ENTITY = 0xffffffffu;
+
+// how an entity is shaded: its own texture and uniforms, or an entry in a MaterialBatch
+struct MaterialRef {
+  std::shared_ptr<TextureAsset> texture;
+  glm::vec3 specular;
+  float shininess;
+  // entry in a MaterialBatch, -1 draws with texture and the material uniforms
+  int batchIndex;
+};
+
+// Entities of the scene with their components in packed arrays, one entry per live entity
+// in the same order for every component. destroy() moves the last entity into the freed
+// slot, so the arrays never have holes and the systems below walk them front to back
+// without chasing pointers: updateTransforms() for the hierarchy, updateBounds() for
+// world-space bounds, cull() for the frustum and submit() for the draw list. RenderObject
+// is a handle onto one entity for code that works with single objects.
+//
+// Entities can hang under a parent and follow it. setTransform() and setParent() only flag
+// the entity; updateTransforms() walks the entities grouped by depth in the hierarchy, so a
+// parent is final before its children, and recomputes just the flagged ones and everything
+// below them, each level as one batch of SIMD matrix products.
+class SceneWorld {
+  public:
+    SceneWorld();
+
+    // an entity with identity transform, no mesh and no material
+    Entity create();
+    void destroy(Entity entity);
+    bool alive(Entity entity) const { return entity < slots.size() && slots[entity] != NO_ENTITY; }
+    size_t size() const { return entities.size(); }
+
+    // position of a live entity in the component arrays, changes when another is destroyed
+    uint32_t index(Entity entity) const { return slots[entity]; }
+    Entity entity(uint32_t index) const { return entities[index]; }
+
+    // components by index, only create() and destroy() resize them
+    // transform relative to the parent, or the world for roots, change it with setTransform()
+    std::vector<glm::mat4> locals;
+    // NO_ENTITY for roots, change it with setParent()
+    std::vector<Entity> parents;
+    // world matrices and their inverse transposes for the normals, written by updateTransforms()
+    std::vector<glm::mat4> transforms;
+    std::vector<glm::mat3> normalMatrices;
+    std::vector<std::shared_ptr<MeshAsset> > meshes;
+    // set to draw one copy per entry with a single instanced draw, transforms are then unused
+    std::vector<std::shared_ptr<InstanceBuffer> > instances;
+    std::vector<MaterialRef> materials;
+    // level each entity was last drawn at, the hysteresis state of selectLod
+    std::vector<unsigned int> lods;
+    // world-space bounding spheres written by updateBounds(), covering every instance; for
+    // culling whole entities, distances to the nearest copy come from instanceSphere()
+    std::vector<float> boundsX, boundsY, boundsZ, boundsRadius;
+    // 1 for entities that passed the last cull()
+    std::vector<uint8_t> visible;
+
+    bool ready(uint32_t index) const;
+    // copies drawn by drawLod
+    unsigned int instanceCount(uint32_t index) const { return instances[index] ? static_cast<unsigned int>(instances[index]->size()) : 1; }
+
+    // the entity and everything below it move with the next updateTransforms()
+    void setTransform(uint32_t index, const glm::mat4 &local);
+    // hangs entity under parent keeping its local transform, NO_ENTITY makes it a root.
+    // False if parent is the entity itself or below it.
+    bool setParent(Entity entity, Entity parent);
+    // recomputes the world and normal matrices and the bounds of the entities that moved
+    // since the last call, returns how many did
+    size_t updateTransforms();
+    // indices of the entities the last updateTransforms() moved, for systems keeping their
+    // own copy of transforms or bounds
+    const std::vector<uint32_t> &movedIndices() const { return moved; }
+
+    // every entity's bounds, call after instance lists or meshes change; updateTransforms()
+    // keeps them current for moved entities. Entities still loading get an unbounded
+    // sphere that is never culled.
+    void updateBounds();
+    // tests every entity's bounds against the frustum, returns the number visible
+    size_t cull(const Frustum &frustum);
+    // queues the ready entities that passed the last cull(), all of them if it never ran
+    void submit(RenderQueue &queue, Shader &shader, RenderPass pass = PASS_OPAQUE);
+
+    // the level picked from the projected simplification error of the copy nearest the view,
+    // out of subset (instance indices) or every copy
+    unsigned int selectLod(uint32_t index, const RenderView &view, const std::vector<uint32_t> *subset = NULL);
+    // matrix and world-space sphere of one copy, instance is ignored without an instance list
+    const glm::mat4 &instanceModel(uint32_t index, size_t instance) const { return instances[index] ? instances[index]->get(instance) : transforms[index]; }
+    void instanceSphere(uint32_t index, size_t instance, glm::vec3 &center, float &radius) const;
+    // the pieces of a draw, so RenderQueue can skip the state that did not change
+    void bindMaterial(uint32_t index, Shader &shader);
+    // positionsOnly binds the mesh's position stream for a DEPTH_ONLY shader
+    void bindMesh(uint32_t index, Shader &shader, bool positionsOnly = false);
+    // the same with the matrices a non-instanced entity is drawn with given, for draws
+    // recorded before the entity moved again
+    void bindMesh(uint32_t index, Shader &shader, const glm::mat4 &transform, const glm::mat3 &normal, bool positionsOnly = false);
+    void drawLod(uint32_t index, const MeshLod &lod);
+
+  private:
+    // dense index by entity, NO_ENTITY for free handles
+    std::vector<uint32_t> slots;
+    // entity by dense index
+    std::vector<Entity> entities;
+    std::vector<Entity> freeEntities;
+
+    // set by setTransform() and setParent() until updateTransforms() clears it
+    std::vector<uint8_t> dirty;
+    bool anyDirty;
+    // indices sorted by depth in the hierarchy, level d is [levelEnds[d - 1], levelEnds[d])
+    std::vector<uint32_t> order;
+    std::vector<size_t> levelEnds;
+    // order has to be rebuilt after entities or parents changed
+    bool orderValid;
+    // scratch of updateTransforms()
+    std::vector<uint32_t> batch, batchParents, moved;
+
+    void buildOrder();
+    // world-space sphere of one entity
+    void measure(size_t index);
+
+    template <typename T>
+    static void removeAt(std::vector<T> &values, uint32_t index);
+
+    SceneWorld(const SceneWorld &);
+    SceneWorld &operator=(const SceneWorld &);
+};
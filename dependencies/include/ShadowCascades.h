@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shaders/shader.h>
+#include <RenderView.h>
+
+const int SHADOW_CASCADES = 3;
+const int SHADOW_MAP_SIZE = 1024;
+// shadows end this far from the camera, the cascades split the range between it and the
+// near plane
+const float SHADOW_DISTANCE = 30.0f;
+// blend between uniform (0) and logarithmic (1) split distances
+const float SHADOW_SPLIT_LAMBDA = 0.75f;
+// a cascade covers its frustum slice plus this fraction of its radius, so the camera can move
+// a little before the cached map stops covering the view
+const float SHADOW_MARGIN = 0.25f;
+// casters this far towards the light from a slice still land in its map
+const float SHADOW_CASTER_DISTANCE = 10.0f;
+// cascades re-rendered at most per frame, the rest wait for later frames
+const int SHADOW_UPDATES_PER_FRAME = 1;
+// a cascade is re-rendered once the sun turned as far as it does in this time since the map was
+// drawn. Has to be well above SHADOW_CASCADES / SHADOW_UPDATES_PER_FRAME frames, or every
+// cascade is stale again by the time its turn comes and the cache never hits.
+const float SHADOW_LAG_SECONDS = 0.1f;
+// texture unit of the shadow maps, after the material array, depth pyramid and light buffers
+const int SHADOW_TEXTURE_UNIT = 5;
+// frames per log line
+const unsigned int SHADOW_REPORT_FRAMES = 300;
+
+// What drawing one frame needs of the schedule, so the maps can be drawn on another thread
+// than the one that scheduled them: the cascades to redraw and every cascade's light camera.
+struct ShadowFrame {
+  int updates;
+  int cascades[SHADOW_UPDATES_PER_FRAME];
+  glm::mat4 views[SHADOW_CASCADES];
+  glm::mat4 projections[SHADOW_CASCADES];
+  // bit i set when cascade i holds a map
+  int mask;
+};
+
+// Cascaded shadow maps for the sun, cached between frames. Each cascade is an orthographic
+// depth map around the bounding sphere of one slice of the camera frustum, rendered with some
+// margin into one layer of a depth texture array. A cascade keeps the matrix it was drawn
+// with, so a cached map stays correct for the static scene until the sun turns by more than
+// SHADOW_LAG_SECONDS worth of its motion or the camera leaves its margin. schedule() picks at most
+// SHADOW_UPDATES_PER_FRAME cascades per frame: first the ones that no longer cover their
+// slice, nearest first, then the stalest of those the sun has moved away from. The
+// CASCADED_SHADOWS variant of the OBJECT shader uses the finest cascade that holds the
+// fragment, so the draw cost of shadows is spread over frames instead of paid per cascade
+// per frame.
+class ShadowCascades {
+  public:
+    // defines selecting the OBJECT shader variant, on top of the pass's other defines
+    static std::string shaderDefines();
+
+    // sunSpeed: radians per second the sun turns at, sets how far it may turn before a map is stale
+    explicit ShadowCascades(float sunSpeed);
+    ~ShadowCascades();
+
+    // GL thread only, creates the depth array and framebuffer
+    bool init();
+
+    // the cascade to re-render this frame for the camera and the direction the sunlight
+    // travels, -1 if every map is still good. Call until it returns -1 to use the budget.
+    int schedule(const RenderView &view, const glm::vec3 &lightDirection);
+    // light camera of a cascade, for the Frame block while drawing it
+    const glm::mat4 &view(int cascade) const { return cascades[cascade].view; }
+    const glm::mat4 &projection(int cascade) const { return cascades[cascade].projection; }
+
+    // targets the cascade's layer; draw the casters with a DEPTH_ONLY shader, then end()
+    void begin(int cascade);
+    // back to the default framebuffer and the window's viewport
+    void end(int width, int height);
+
+    // the light cameras and valid cascades as of the last schedule(), leaves the updates
+    void capture(ShadowFrame &frame) const;
+    // binds the maps and sets the cascade uniforms of frame, shader must be in use
+    void bind(Shader &shader, const ShadowFrame &frame);
+    // call once per frame: ends the frame's update budget and logs how many cascades were
+    // drawn every SHADOW_REPORT_FRAMES frames
+    void report();
+
+  private:
+    struct Cascade {
+      glm::mat4 view;
+      glm::mat4 projection;
+      // world-space sphere the map covers and the sun it was drawn for
+      glm::vec3 center;
+      float radius;
+      glm::vec3 direction;
+      unsigned int renderedFrame;
+      bool valid;
+    };
+
+    Cascade cascades[SHADOW_CASCADES];
+    unsigned int texture, framebuffer;
+    unsigned int frame;
+    // cosine of the angle the sun may turn before a map is stale
+    float cosThreshold;
+    // updates already handed out this frame
+    int scheduled;
+
+    unsigned int renders;
+    unsigned int reportFrames;
+
+    // bounding sphere of the camera frustum between two view depths
+    static void sliceSphere(const RenderView &view, float nearDepth, float farDepth, glm::vec3 &center, float &radius);
+    void fit(Cascade &cascade, const glm::vec3 &center, float radius, const glm::vec3 &direction);
+
+    ShadowCascades(const ShadowCascades &);
+    ShadowCascades &operator=(const ShadowCascades &);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <shaders/shader.h>
+#include <mesh/VertexFormat.h>
+
+class MeshAsset;
+class TextureAsset;
+
+enum AssetType {
+  ASSET_MESH,
+  ASSET_TEXTURE,
+  ASSET_SHADER,
+  ASSET_TYPE_COUNT
+};
+
+struct AssetMemory {
+  long long count;
+  long long cpuBytes;
+  long long gpuBytes;
+};
+
+// Hands out shared, reference-counted asset handles keyed by canonical path (plus vertex
+// format for meshes), so every object using the same file shares one GPU copy. The registry
+// only keeps weak references: an asset is destroyed with its last handle. It must outlive
+// every handle it gave out.
+class AssetRegistry {
+  public:
+    AssetRegistry();
+
+    // created is set when the handle is new and still has to be loaded and uploaded
+    std::shared_ptr<MeshAsset> mesh(const std::string &path, VertexFormat format, bool &created);
+    std::shared_ptr<TextureAsset> texture(const std::string &path, bool &created);
+    // one program per type and define set
+    std::shared_ptr<Shader> shader(Type type, const std::string &defines = "");
+
+    // memory bookkeeping, called by the assets themselves
+    void track(AssetType type, long long count, long long cpuBytes, long long gpuBytes);
+    AssetMemory memory(AssetType type) const;
+    void printMemory() const;
+
+  private:
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<MeshAsset> > meshes;
+    std::map<std::string, std::weak_ptr<TextureAsset> > textures;
+    std::map<std::string, std::weak_ptr<Shader> > shaders;
+
+    std::atomic<long long> counts[ASSET_TYPE_COUNT];
+    std::atomic<long long> cpuBytes[ASSET_TYPE_COUNT];
+    std::atomic<long long> gpuBytes[ASSET_TYPE_COUNT];
+
+    AssetRegistry(const AssetRegistry &);
+    AssetRegistry &operator=(const AssetRegistry &);
+};
+
+// realpath() of the file, or the path unchanged when it cannot be resolved
+std::string canonicalAssetPath(const std::string &path);
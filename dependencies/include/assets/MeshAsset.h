@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+#include <mesh/Mesh.h>
+#include <mesh/MeshCache.h>
+#include <mesh/VertexFormat.h>
+
+class AssetRegistry;
+
+// GPU-resident mesh shared by every object drawing the same file. Only GL handles and the
+// small LOD/bounds tables stay on the CPU once uploaded.
+class MeshAsset {
+  public:
+    std::string path;
+    VertexFormat format;
+    unsigned int VAO, VBO, EBO;
+    // positions only, same vertex order and EBO as VAO, for depth-only passes
+    unsigned int depthVAO, positionVBO;
+    GLenum indexType;
+    VertexQuantization quantization;
+    std::vector<MeshLod> lods;
+    MeshBounds bounds;
+    // sizes of the VBO, EBO and positionVBO contents
+    size_t vertexBytes, indexBytes, positionBytes;
+
+    MeshAsset(const std::string &path, VertexFormat format, AssetRegistry *registry);
+    ~MeshAsset();
+
+    bool ready() const { return VAO != 0; }
+    size_t indexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int); }
+
+    // GL thread only, releases the CPU copy in mesh afterwards
+    void upload(LoadedMesh &mesh);
+
+  private:
+    AssetRegistry *registry;
+    long long gpuBytes;
+
+    MeshAsset(const MeshAsset &);
+    MeshAsset &operator=(const MeshAsset &);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <glad/glad.h>
+#include <texture/Image.h>
+
+class AssetRegistry;
+
+class TextureAsset {
+  public:
+    std::string path;
+    unsigned int ID;
+    int width, height;
+
+    TextureAsset(const std::string &path, AssetRegistry *registry);
+    ~TextureAsset();
+
+    bool ready() const { return ID != 0; }
+
+    // GL thread only, releases the decoded pixels afterwards
+    void upload(LoadedImage &image);
+
+    // GL thread only: allocates every level of image's mip chain and uploads the levels no
+    // larger than placeholderSize right away. Returns the finest resident level, the coarser
+    // ones in between are left for TextureStreamer.
+    int allocate(const LoadedImage &image, int placeholderSize);
+    // sampling is clamped to levels that have been uploaded
+    void setBaseLevel(int level);
+
+  private:
+    AssetRegistry *registry;
+    long long gpuBytes;
+
+    TextureAsset(const TextureAsset &);
+    TextureAsset &operator=(const TextureAsset &);
+};
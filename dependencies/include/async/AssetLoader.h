@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <async/ThreadPool.h>
+#include <assets/AssetRegistry.h>
+#include <mesh/MeshCache.h>
+#include <texture/Image.h>
+#include <texture/TextureStreamer.h>
+
+class RenderObject;
+class RenderLight;
+class MeshAsset;
+class TextureAsset;
+
+// Decodes meshes and images on a thread pool while the GL thread only performs the uploads.
+// Assets come from the registry, so a file shared by several objects is decoded and uploaded
+// once; objects draw nothing until their assets are uploaded by poll()/finish(). Textures
+// start out as a low resolution placeholder and their finer levels stream in through update()
+// at most uploadBudget bytes per frame.
+class AssetLoader {
+  public:
+    explicit AssetLoader(AssetRegistry &registry, size_t uploadBudget = DEFAULT_UPLOAD_BUDGET, unsigned int threadCount = 0);
+
+    void loadObject(RenderObject &object, const std::string &modelPath, const std::string &texturePath);
+    void loadLight(RenderLight &light, const std::string &modelPath);
+
+    std::shared_ptr<MeshAsset> loadMesh(const std::string &modelPath, VertexFormat format);
+    std::shared_ptr<TextureAsset> loadTexture(const std::string &texturePath);
+
+    // GL thread only: uploads every asset whose CPU work is done and returns how many are still pending
+    size_t poll();
+    // GL thread only: blocks until every queued asset has been uploaded, textures as placeholders
+    void finish();
+    // GL thread only, once per frame: poll() plus one streaming step
+    void update();
+
+  private:
+    struct Job {
+      std::shared_ptr<MeshAsset> mesh;
+      std::shared_ptr<TextureAsset> texture;
+      LoadedMesh meshData;
+      std::shared_ptr<LoadedImage> image;
+    };
+
+    AssetRegistry &registry;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::shared_ptr<Job> > completed;
+    size_t pending;
+    double startTime;
+    TextureStreamer streamer;
+
+    // declared last so its workers are joined before the queues they report into go away
+    ThreadPool pool;
+
+    void enqueue();
+    void taskDone(const std::shared_ptr<Job> &job);
+    void upload(Job &job);
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <RenderView.h>
+#include <RenderQueue.h>
+#include <ShadowCascades.h>
+#include <ClusteredLights.h>
+#include <InstanceBuffer.h>
+#include <shaders/UniformBlocks.h>
+#include <async/SpscQueue.h>
+
+class IndirectQueue;
+
+// one being drawn, one waiting for the render thread and one being filled
+const size_t FRAME_SNAPSHOTS = 3;
+
+// Everything the render thread needs of one simulation step. The input thread fills it and
+// never touches it again once published: draw lists are finished, with the matrices of every
+// entity drawn once copied in, so the render thread never reads the live SceneWorld.
+struct FrameSnapshot {
+  // glfwGetTime() of the step, drives the animations
+  float time;
+  RenderView view;
+  // camera and light for the Frame uniform block
+  FrameUniforms uniforms;
+  int framebufferWidth, framebufferHeight;
+  bool depthPrepass;
+
+  // sorted camera pass of the CPU path, with the arena part in indirectQueue; one
+  // IndirectQueue per snapshot, set up by the owner since it holds GL buffers
+  RenderQueue queue;
+  IndirectQueue *indirectQueue;
+  // casters of shadows.cascades[i] in shadowQueues[i], with the arena part in
+  // shadowIndirectQueues[i], set up like indirectQueue
+  ShadowFrame shadows;
+  RenderQueue shadowQueues[SHADOW_UPDATES_PER_FRAME];
+  IndirectQueue *shadowIndirectQueues[SHADOW_UPDATES_PER_FRAME];
+  LightClusters lights;
+  // entities the step moved and their new matrices, for the GPU culler's copy of the instances
+  std::vector<uint32_t> moved;
+  std::vector<InstanceTransform> movedTransforms;
+
+  glm::vec3 lightPosition() const { return glm::vec3(uniforms.lightPosition); }
+};
+
+// Hands FrameSnapshots from the thread that polls input and simulates to the thread that owns
+// the GL context. The snapshots are allocated once and go round through two lock-free queues:
+// published ones to the render thread, drawn ones back to the input thread, so the next step
+// is simulated while the last one is being submitted. Every published snapshot is drawn, in
+// order: a step schedules shadow map updates only once, skipping it would lose them. The
+// mutex and condition variable next to the queues only put an idle render thread to sleep,
+// handing snapshots over never takes the lock.
+class FramePipeline {
+  public:
+    FramePipeline();
+
+    // before either thread uses the pipeline, to attach per-snapshot resources
+    FrameSnapshot &snapshot(size_t i) { return snapshots[i]; }
+
+    // input thread: a snapshot to fill, NULL while all of them are queued or being drawn
+    FrameSnapshot *acquire();
+    // input thread: hands a snapshot from acquire() over to the render thread
+    void publish(FrameSnapshot *snapshot);
+    // input thread: whether the render thread has not yet taken a published snapshot
+    bool pending() const { return !published.empty(); }
+
+    // render thread: the oldest published snapshot, NULL if none arrived since the last call.
+    // The previous result is released then, so a snapshot stays valid until the next call
+    // that returns another one.
+    FrameSnapshot *next();
+    // render thread: sleeps until a snapshot is published or seconds have passed
+    void wait(double seconds);
+
+  private:
+    FrameSnapshot snapshots[FRAME_SNAPSHOTS];
+    // room for every snapshot, so a push never fails
+    SpscQueue<FrameSnapshot*, 4> published, released;
+    // the render thread's snapshot
+    FrameSnapshot *current;
+    std::mutex sleepMutex;
+    std::condition_variable publishedSignal;
+
+    FramePipeline(const FramePipeline &);
+    FramePipeline &operator=(const FramePipeline &);
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <cstdint>
+
+typedef uint32_t JobId;
+// stands for a job that is already done, dependencies on it are ignored
+const JobId NO_JOB = 0xffffffffu;
+// jobs between two reset() calls, add() runs the task on the spot once they are used up
+const size_t MAX_FRAME_JOBS = 4096;
+// frames per log line
+const unsigned int JOB_REPORT_FRAMES = 300;
+
+// Work-stealing scheduler for the CPU stages of a frame. Every thread has its own deque:
+// jobs made ready on a thread go to the back of its deque and it takes them back from there
+// (the data they touch is still in its cache), idle threads steal from the front of the
+// others' deques. A job starts once the jobs it was added after have finished, each job
+// counting its unfinished dependencies down as they complete. The thread that creates the
+// system is one of the workers while it sits in wait(), so it should be the one that needs
+// the results, like the thread simulating the frames: jobs do the CPU work, that thread hands
+// it on once the jobs it needs are done. add(), parallelFor(), wait() and reset() are for that
+// thread only.
+class JobSystem {
+  public:
+    // threadCount 0 starts one worker per hardware thread besides the calling one
+    explicit JobSystem(unsigned int threadCount = 0);
+    ~JobSystem();
+
+    // task runs once every job in after has finished
+    JobId add(const std::function<void()> &task, std::initializer_list<JobId> after = std::initializer_list<JobId>());
+    // body(first, last) over [0, count) in slices of at most grain, on as many threads as
+    // are free. The returned job finishes with the last slice.
+    JobId parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body,
+                      std::initializer_list<JobId> after = std::initializer_list<JobId>());
+    // runs jobs on the calling thread until job has finished
+    void wait(JobId job);
+    // waits for every job, then frees the slots for the next frame and logs the frame's
+    // counts every JOB_REPORT_FRAMES frames
+    void reset();
+
+    // threads running jobs, the workers and the creating thread
+    unsigned int size() const { return queueCount; }
+
+  private:
+    struct Job {
+      std::function<void()> task;
+      // unfinished dependencies, plus one while add() is still wiring the job up
+      std::atomic<int> pending;
+      std::atomic<bool> done;
+      // jobs waiting on this one, guarded by graphMutex
+      std::vector<JobId> dependents;
+    };
+
+    // one per thread, index 0 is the creating thread
+    struct Queue {
+      std::mutex mutex;
+      std::deque<JobId> jobs;
+    };
+
+    std::unique_ptr<Job[]> jobs;
+    JobId nextJob;
+    std::unique_ptr<Queue[]> queues;
+    // fixed before the workers start, they read it without a lock
+    unsigned int queueCount;
+    std::vector<std::thread> workers;
+
+    std::mutex graphMutex;
+    // queued and stopping change under sleepMutex, so sleepers never miss them
+    std::mutex sleepMutex;
+    std::condition_variable available, finished;
+    std::atomic<int> queued;
+    std::atomic<int> unfinished;
+    bool stopping;
+
+    // per frame and summed over JOB_REPORT_FRAMES frames
+    std::atomic<unsigned int> stolen;
+    unsigned long long totalJobs, totalStolen;
+    unsigned int totalFrames;
+
+    JobId addJob(const std::function<void()> &task, const JobId *after, size_t afterCount);
+    void schedule(JobId job);
+    // runs one job from the thread's own deque or stolen from another, false if none was found
+    bool runOne(unsigned int self);
+    void finish(JobId job);
+    void workerLoop(unsigned int self);
+    void report(unsigned int frameJobs);
+
+    JobSystem(const JobSystem &);
+    JobSystem &operator=(const JobSystem &);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded queue between exactly one producer thread and one consumer thread, without locks.
+// head is only written by the consumer and tail only by the producer; each publishes its
+// index with a release store after touching the slot, and the other side reads it with an
+// acquire load, so an element is complete before it can be popped and free before it can be
+// overwritten. Holds up to Capacity - 1 elements.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  public:
+    SpscQueue() : head(0), tail(0) {}
+
+    // producer only, false if the queue is full
+    bool push(const T &value) {
+      size_t back = tail.load(std::memory_order_relaxed);
+      size_t next = (back + 1) & (Capacity - 1);
+      if (next == head.load(std::memory_order_acquire))
+        return false;
+      items[back] = value;
+      tail.store(next, std::memory_order_release);
+      return true;
+    }
+
+    // consumer only, false if the queue is empty
+    bool pop(T &value) {
+      size_t front = head.load(std::memory_order_relaxed);
+      if (front == tail.load(std::memory_order_acquire))
+        return false;
+      value = items[front];
+      head.store((front + 1) & (Capacity - 1), std::memory_order_release);
+      return true;
+    }
+
+    // either side, the other one may change it right after
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+  private:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity has to be a power of two");
+
+    T items[Capacity];
+    // on separate cache lines, so pushing and popping do not invalidate each other's index
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+
+    SpscQueue(const SpscQueue &);
+    SpscQueue &operator=(const SpscQueue &);
+};
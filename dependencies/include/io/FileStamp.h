@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// size and modification time (ns) of a source file, stored in caches to detect stale data
+bool fileStamp(const std::string &path, uint64_t &size, int64_t &mtime);
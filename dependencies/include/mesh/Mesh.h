@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// interleaved vertex layout: position (3), normal (3), texture coordinates (2)
+const unsigned int FLOATS_PER_VERTEX = 8;
+
+// A contiguous range of the index buffer. error is the largest object-space deviation from LOD 0.
+struct MeshLod {
+  unsigned int indexOffset;
+  unsigned int indexCount;
+  float error;
+};
+
+struct MeshBounds {
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::vec3 center;
+  float radius;
+};
+
+struct MeshData {
+  std::vector<float> vertices;
+  // every LOD's triangles back to back, finest first
+  std::vector<unsigned int> indices;
+  std::vector<MeshLod> lods;
+  MeshBounds bounds;
+
+  unsigned int vertexCount() const { return static_cast<unsigned int>(vertices.size() / FLOATS_PER_VERTEX); }
+  // 16-bit indices are enough as long as every vertex can be addressed by one
+  GLenum indexType() const { return vertexCount() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT; }
+};
+
+// Collapses a triangle soup (one vertex per face corner) into unique vertices plus an index list.
+MeshData weldVertices(const std::vector<float> &soup);
+void printWeldStats(const std::string &name, size_t soupVertexCount, const MeshData &mesh);
+
+// Fills mesh.bounds with the AABB and a sphere around its center.
+void computeBounds(MeshData &mesh);
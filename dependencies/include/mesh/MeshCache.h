@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+#include <mesh/Mesh.h>
+#include <mesh/VertexFormat.h>
+
+// Binary mesh cache stored next to the OBJ file (<model>.obj.lmesh). It holds the final
+// interleaved vertices and GPU-width indices so a warm start skips OBJ parsing entirely.
+// Layout: header, vertices, indices (all LODs), MeshLod[lodCount], MeshBounds.
+const uint32_t MESH_CACHE_VERSION = 4;
+
+struct MeshCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint32_t floatsPerVertex;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t indexSize;
+  uint32_t lodCount;
+  uint32_t reserved;
+};
+
+// Upload-ready mesh data, either memory-mapped from a cache file or owned in memory.
+class LoadedMesh {
+  public:
+    LoadedMesh();
+    ~LoadedMesh();
+
+    // maps <objPath>.lmesh, fails if it is missing, stale or from another format version
+    bool openCache(const std::string &objPath);
+    void assign(MeshData &mesh);
+    // re-encodes the vertex stream into a packed GPU layout, indices are left untouched
+    void pack(VertexFormat format, VertexPackStats &stats);
+    void release();
+
+    const void *vertexData() const;
+    size_t vertexBytes() const;
+    const void *indexData() const;
+    size_t indexBytes() const;
+    unsigned int vertexCount() const;
+    unsigned int indexCount() const;
+    GLenum indexType() const;
+    const std::vector<MeshLod> &lods() const { return levels; }
+    const MeshBounds &bounds() const { return meshBounds; }
+    bool fromCache() const { return mapping != NULL; }
+    VertexFormat format() const { return vertexFormat; }
+    const VertexQuantization &quantization() const { return positionQuantization; }
+
+  private:
+    void *mapping;
+    size_t mappingSize;
+    MeshCacheHeader header;
+    std::vector<float> vertices;
+    std::vector<unsigned char> indices;
+    std::vector<MeshLod> levels;
+    MeshBounds meshBounds;
+    VertexFormat vertexFormat;
+    VertexQuantization positionQuantization;
+    std::vector<unsigned char> packedVertices;
+
+    LoadedMesh(const LoadedMesh &);
+    LoadedMesh &operator=(const LoadedMesh &);
+};
+
+std::string meshCachePath(const std::string &objPath);
+bool writeMeshCache(const std::string &objPath, const MeshData &mesh);
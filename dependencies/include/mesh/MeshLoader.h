@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mesh/Mesh.h>
+#include <mesh/MeshCache.h>
+
+// Flattens every OBJ face corner into its own interleaved vertex (triangle soup). Parses on
+// the calling thread, callers run it on their own workers.
+std::vector<float> loadObjModel(const std::string &path);
+
+// Maps the binary cache when it is fresh, otherwise parses and welds the OBJ and refreshes the cache.
+// A packed format re-encodes the vertices afterwards. Touches no GL state, so it is safe to
+// call from worker threads.
+void loadMesh(const std::string &objPath, LoadedMesh &mesh, VertexFormat format = VERTEX_FLOAT);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mesh/Mesh.h>
+
+// Post-transform vertex cache simulation. ACMR is misses per triangle (0.5 is the ideal for
+// regular grids, 3 is no reuse), ATVR is misses per unique vertex (1 is ideal).
+struct VertexCacheStats {
+  float acmr;
+  float atvr;
+};
+
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount);
+
+// Splits the cache-ordered triangles into clusters at cache-cold boundaries and draws the
+// outward-facing clusters first, so the view-independent order rejects more fragments early.
+// The new order is dropped if it raises ACMR above threshold times the input's.
+void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<float> &vertices, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so vertex fetch walks memory linearly.
+void optimizeVertexFetch(MeshData &mesh);
+
+// Runs the three passes above (the first two per LOD range) and prints LOD 0's ACMR/ATVR
+// before and after.
+void optimizeMesh(MeshData &mesh, const std::string &name);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <mesh/Mesh.h>
+
+// Quadric error metric edge-collapse simplification (Garland & Heckbert). Vertices that share
+// a position are collapsed together so flat-shaded and uv-seamed meshes do not tear apart;
+// collapses only ever move onto existing vertices, so every LOD shares the mesh's vertex buffer.
+// Returns the simplified index list, error receives how far the farthest removed vertex lies
+// from the simplified surface, in object units.
+std::vector<unsigned int> simplifyMesh(const std::vector<float> &vertices, const std::vector<unsigned int> &indices,
+                                       size_t targetIndexCount, float &error);
+
+const unsigned int MAX_MESH_LODS = 4;
+
+// Appends up to MAX_MESH_LODS - 1 coarser levels (1/2, 1/4, 1/8 of the triangles) after LOD 0
+// in mesh.indices and describes every level in mesh.lods.
+void generateLods(MeshData &mesh, const std::string &name);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+// Memory-mapped OBJ reader. Large files are split into line-aligned chunks parsed on
+// separate threads, then every face corner is written straight into a pre-sized
+// interleaved vertex stream (position, normal, uv per corner, polygons fanned into triangles).
+// Only v/vt/vn/f records are read; materials, groups and smoothing groups are ignored.
+struct ObjParseStats {
+  size_t bytes;
+  size_t positions;
+  size_t triangles;
+  unsigned int chunks;
+};
+
+// threadCount 0 picks one chunk per hardware thread, files below ~256 KB stay on the calling
+// thread. The threads are spawned per call, callers already on a pool should pass 1.
+bool parseObj(const std::string &path, std::vector<float> &soup, unsigned int threadCount = 0, ObjParseStats *stats = NULL);
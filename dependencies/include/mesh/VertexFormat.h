@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// GPU vertex layouts for RenderObject meshes.
+//   VERTEX_FLOAT            32 bytes: float3 position, float3 normal, float2 uv
+//   VERTEX_PACKED           20 bytes: float3 position, int 2_10_10_10 normal, half2 uv
+//   VERTEX_PACKED_QUANTIZED 16 bytes: unorm16x3 position (+pad) relative to the mesh AABB, normal and uv as above
+enum VertexFormat {
+  VERTEX_FLOAT,
+  VERTEX_PACKED,
+  VERTEX_PACKED_QUANTIZED
+};
+
+// Maps the stored position back to object space in the vertex shader: offset + stored * scale.
+struct VertexQuantization {
+  glm::vec3 offset;
+  glm::vec3 scale;
+
+  VertexQuantization() : offset(0.0f), scale(1.0f) {}
+};
+
+struct VertexPackStats {
+  float maxPositionError;
+  float maxNormalErrorDegrees;
+  float maxUvError;
+};
+
+unsigned int vertexStride(VertexFormat format);
+// bytes per vertex of the position-only stream: the position exactly as the full layout stores it
+unsigned int positionStride(VertexFormat format);
+
+// Re-encodes interleaved float vertices (FLOATS_PER_VERTEX each) into the given layout.
+std::vector<unsigned char> packVertices(const float *vertices, unsigned int vertexCount, VertexFormat format,
+                                        VertexQuantization &quantization, VertexPackStats &stats);
+void printPackStats(const std::string &name, VertexFormat format, const VertexPackStats &stats);
+// Copies the positions out of packed vertices into a tightly packed stream for depth-only passes.
+std::vector<unsigned char> extractPositions(const void *vertices, unsigned int vertexCount, VertexFormat format);
+
+// Points attributes 0 (position), 1 (normal) and 2 (uv) of the bound VAO at the bound GL_ARRAY_BUFFER.
+void setupVertexAttributes(VertexFormat format);
+// Points attribute 0 of the bound VAO at a stream built by extractPositions.
+void setupPositionAttribute(VertexFormat format);
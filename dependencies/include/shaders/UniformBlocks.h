@@ -0,0 +1,76 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <type_traits>
+
+// 32-bit FNV-1a of a uniform name, Shader looks locations up by it
+constexpr uint32_t uniformHash(const char *name, uint32_t hash = 2166136261u) {
+  return *name ? uniformHash(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u) : hash;
+}
+
+// hashes a literal at compile time: shader.setVec3(UNIFORM("positionOffset"), offset)
+#define UNIFORM(name) std::integral_constant<uint32_t, uniformHash(name)>::value
+
+// binding points, assigned to every program that declares the block when it is linked
+const unsigned int FRAME_BINDING = 0;
+const unsigned int MATERIAL_BINDING = 1;
+const unsigned int DRAW_BINDING = 2;
+
+// camera and light, written once per frame and shared by every program
+#define FRAME_BLOCK_GLSL \
+  "layout (std140) uniform Frame {\n" \
+  "   mat4 view;\n" \
+  "   mat4 projection;\n" \
+  "   vec4 viewPosition;\n" \
+  "   vec4 lightPosition;\n" \
+  "   vec4 lightAmbient;\n" \
+  "   vec4 lightDiffuse;\n" \
+  "   vec4 lightSpecular;\n" \
+  "};\n"
+
+// std140 mirror of the Frame block, vec3s are padded to vec4
+struct FrameUniforms {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec4 viewPosition;
+  glm::vec4 lightPosition;
+  glm::vec4 lightAmbient;
+  glm::vec4 lightDiffuse;
+  glm::vec4 lightSpecular;
+};
+
+// GL_UNIFORM_BUFFER bound to a fixed binding point and rewritten whole with one call
+class UniformBuffer {
+public:
+    unsigned int ID;
+    GLsizeiptr size;
+
+    UniformBuffer(GLsizeiptr size, unsigned int binding) : size(size)
+    {
+      glGenBuffers(1, &ID);
+      glBindBuffer(GL_UNIFORM_BUFFER, ID);
+      glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+      glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+    }
+    ~UniformBuffer()
+    {
+      glDeleteBuffers(1, &ID);
+    }
+    // ------------------------------------------------------------------------
+    void update(const void *data)
+    {
+      glBindBuffer(GL_UNIFORM_BUFFER, ID);
+      glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+      glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+  UniformBuffer(const UniformBuffer &);
+  UniformBuffer &operator=(const UniformBuffer &);
+};
+#endif
@@ -4,10 +4,19 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <shaders/UniformBlocks.h>
 
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 #include <iostream>
 
+// GL 4.3, not part of the 3.3 glad header
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
 enum Type {
   OBJECT,
   LIGHTSOURCE
@@ -18,45 +27,116 @@ class Shader {
 public:
     unsigned int ID;
 
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, defines (e.g. "#define MATERIAL_ARRAY\n")
+    // are inserted after the #version line to select a variant
     // ------------------------------------------------------------------------
-    Shader(Type shaderType) {
+    Shader(Type shaderType, const std::string &defines = "") {
       if(shaderType == OBJECT) {
         // 1.0 declare shaders
         vShaderCode = "#version 330 core\n"
           "layout (location = 0) in vec3 aPos;\n"
           "layout (location = 1) in vec3 aNormal;\n"
           "layout (location = 2) in vec2 aTexCoords;\n"
+          // per instance, or one constant value for objects drawn once, see InstanceBuffer
+          "layout (location = 3) in mat4 aModel;\n"
 
+          // the depth pre-pass and the shading pass must agree on depth to the bit for GL_EQUAL
+          "invariant gl_Position;\n"
+          "#ifndef DEPTH_ONLY\n"
+          // inverse transpose of aModel, worked out on the CPU, see InstanceTransform
+          "layout (location = 8) in mat3 aNormalMatrix;\n"
           "out vec3 Normal;\n"
           "out vec3 FragPos;\n"
           "out vec2 TexCoords;\n"
+          "#endif\n"
 
-          "uniform mat4 model;\n"
-          "uniform mat4 view;\n"
-          "uniform mat4 projection;\n"
+          FRAME_BLOCK_GLSL
+          // meshes drawn from the shared arena find their draw through the instance, see IndirectQueue
+          "#ifdef INDIRECT_DRAW\n"
+          "struct Draw {\n"
+          "   vec4 positionOffset;\n"
+          "   vec4 positionScale;\n"
+          "   ivec4 material;\n"
+          "};\n"
+          "layout (std140) uniform Draws {\n"
+          "   Draw draws[MAX_INDIRECT_DRAWS];\n"
+          "};\n"
+          "layout (location = 7) in int aDraw;\n"
+          "flat out int drawMaterial;\n"
+          "#define POSITION_OFFSET draws[aDraw].positionOffset.xyz\n"
+          "#define POSITION_SCALE draws[aDraw].positionScale.xyz\n"
+          "#else\n"
+          // dequantizes packed positions, offset 0 / scale 1 for float meshes
+          "uniform vec3 positionOffset;\n"
+          "uniform vec3 positionScale;\n"
+          "#define POSITION_OFFSET positionOffset\n"
+          "#define POSITION_SCALE positionScale\n"
+          "#endif\n"
 
           "void main()\n"
           "{\n"
-          "   FragPos = vec3(model * vec4(aPos, 1.0));\n"
-          "   Normal = mat3(transpose(inverse(model))) * aNormal;\n"
+          "#ifdef INDIRECT_DRAW\n"
+          "   drawMaterial = draws[aDraw].material.x;\n"
+          "#endif\n"
+          "   vec3 position = POSITION_OFFSET + aPos * POSITION_SCALE;\n"
+          "   vec4 worldPosition = aModel * vec4(position, 1.0);\n"
+          "   gl_Position = projection * view * worldPosition;\n"
+          "#ifndef DEPTH_ONLY\n"
+          "   FragPos = vec3(worldPosition);\n"
+          "   Normal = aNormalMatrix * aNormal;\n"
           "   TexCoords = aTexCoords;\n"
-          "   gl_Position = projection * view * vec4(FragPos, 1.0);\n"
+          "#endif\n"
           "}\0";
 
         fShaderCode = "#version 330 core\n"
+          // depth is all the pre-pass writes, see DepthPrepass
+          "#ifdef DEPTH_ONLY\n"
+          "void main()\n"
+          "{\n"
+          "}\n"
+          "#else\n"
+          // every material in one uniform buffer and every albedo map in one texture array,
+          // a draw only selects its entry, see MaterialBatch
+          "#ifdef MATERIAL_ARRAY\n"
           "struct Material {\n"
-          "   sampler2D diffuse;\n"
           "   vec3 specular;\n"
           "   float shininess;\n"
+          "   int layer;\n"
           "};\n"
-
-          "struct Light {\n"
-          "   vec3 ambient;\n"
-          "   vec3 diffuse;\n"
+          "layout (std140) uniform Materials {\n"
+          "   Material materials[MAX_MATERIALS];\n"
+          "};\n"
+          "uniform sampler2DArray albedoMaps;\n"
+          "#ifdef INDIRECT_DRAW\n"
+          "flat in int drawMaterial;\n"
+          "#define MATERIAL materials[drawMaterial]\n"
+          "#else\n"
+          "uniform int materialIndex;\n"
+          "#define MATERIAL materials[materialIndex]\n"
+          "#endif\n"
+          "#define ALBEDO(uv) texture(albedoMaps, vec3(uv, MATERIAL.layer)).rgb\n"
+          "#else\n"
+          "struct Material {\n"
+          "   sampler2D diffuse;\n"
           "   vec3 specular;\n"
-          "   vec3 position;\n"
+          "   float shininess;\n"
           "};\n"
+          "uniform Material material;\n"
+          "#define MATERIAL material\n"
+          "#define ALBEDO(uv) texture(material.diffuse, uv).rgb\n"
+          "#endif\n"
+
+          FRAME_BLOCK_GLSL
+
+          // point lights sorted into view clusters, a fragment only walks its own cluster's
+          // list, see ClusteredLights
+          "#ifdef CLUSTERED_LIGHTS\n"
+          "uniform samplerBuffer pointLights;\n"
+          "uniform usamplerBuffer lightClusters;\n"
+          "uniform usamplerBuffer lightIndices;\n"
+          // xy: clusters per pixel, z/w: scale and bias from log(view depth) to the slice
+          "uniform vec4 clusterParameters;\n"
+          "#endif\n"
 
           "out vec4 FragColor;\n"
 
@@ -64,35 +144,79 @@ public:
           "in vec3 Normal;\n"
           "in vec2 TexCoords;\n"
 
-          "uniform Light light;\n"
-          "uniform Material material;\n"
-          "uniform vec3 viewPos;\n"
+          // cached sun shadow maps, the finest cascade holding the fragment decides, see
+          // ShadowCascades
+          "#ifdef CASCADED_SHADOWS\n"
+          "uniform sampler2DArrayShadow shadowMaps;\n"
+          "uniform mat4 shadowMatrices[SHADOW_CASCADES];\n"
+          // bit i is set once cascade i has been drawn
+          "uniform int shadowMask;\n"
+          "float sunVisibility()\n"
+          "{\n"
+          "   for (int i = 0; i < SHADOW_CASCADES; i++) {\n"
+          "      if ((shadowMask & (1 << i)) == 0)\n"
+          "         continue;\n"
+          "      vec3 coords = (shadowMatrices[i] * vec4(FragPos, 1.0)).xyz;\n"
+          "      if (all(greaterThan(coords, vec3(0.0))) && all(lessThan(coords, vec3(1.0))))\n"
+          "         return texture(shadowMaps, vec4(coords.xy, float(i), coords.z));\n"
+          "   }\n"
+          "   return 1.0;\n"
+          "}\n"
+          "#endif\n"
+
 
           "void main()\n"
           "{\n"
           // ambient
-          "   vec3 ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;\n"
+          "   vec3 albedo = ALBEDO(TexCoords);\n"
+          "   vec3 ambient = lightAmbient.rgb * albedo;\n"
           // diffuse
           "   vec3 norm = normalize(Normal);\n"
-          "   vec3 lightDir = normalize(light.position - FragPos);\n"
+          "   vec3 lightDir = normalize(lightPosition.xyz - FragPos);\n"
           "   float diff = max(dot(norm, lightDir), 0.0);\n"
-          "   vec3 diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;\n"
+          "   vec3 diffuse = lightDiffuse.rgb * diff * albedo;\n"
           // specular
-          "   vec3 viewDir = normalize(viewPos - FragPos);\n"
+          "   vec3 viewDir = normalize(viewPosition.xyz - FragPos);\n"
           "   vec3 reflectDir = reflect(-lightDir, norm);\n"
-          "   float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);\n"
-          "   vec3 specular = light.specular * (spec * material.specular);\n"
+          "   float spec = pow(max(dot(viewDir, reflectDir), 0.0), MATERIAL.shininess);\n"
+          "   vec3 specular = lightSpecular.rgb * (spec * MATERIAL.specular);\n"
+
+          "#ifdef CASCADED_SHADOWS\n"
+          "   float sun = sunVisibility();\n"
+          "#else\n"
+          "   float sun = 1.0;\n"
+          "#endif\n"
+          "   vec3 result = ambient + sun * (diffuse + specular);\n"
 
-          "   vec3 result = ambient + diffuse + specular;\n"
+          "#ifdef CLUSTERED_LIGHTS\n"
+          "   float viewDepth = -(view * vec4(FragPos, 1.0)).z;\n"
+          "   ivec3 cluster = ivec3(gl_FragCoord.xy * clusterParameters.xy, max(log(viewDepth) * clusterParameters.z + clusterParameters.w, 0.0));\n"
+          "   cluster = min(cluster, ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));\n"
+          "   uvec2 range = texelFetch(lightClusters, (cluster.z * CLUSTER_Y + cluster.y) * CLUSTER_X + cluster.x).rg;\n"
+          "   for (uint i = 0u; i < range.y; i++) {\n"
+          "      int light = int(texelFetch(lightIndices, int(range.x + i)).r);\n"
+          "      vec4 positionRadius = texelFetch(pointLights, light * 2);\n"
+          "      vec3 color = texelFetch(pointLights, light * 2 + 1).rgb;\n"
+          "      vec3 toLight = positionRadius.xyz - FragPos;\n"
+          "      float distance = length(toLight);\n"
+          "      vec3 pointDir = toLight / max(distance, 1e-4);\n"
+          // smooth falloff that reaches zero at the radius the lights were culled with
+          "      float falloff = clamp(1.0 - distance / positionRadius.w, 0.0, 1.0);\n"
+          "      falloff *= falloff;\n"
+          "      float pointDiff = max(dot(norm, pointDir), 0.0);\n"
+          "      float pointSpec = pow(max(dot(viewDir, reflect(-pointDir, norm)), 0.0), MATERIAL.shininess);\n"
+          "      result += falloff * color * (pointDiff * albedo + pointSpec * MATERIAL.specular);\n"
+          "   }\n"
+          "#endif\n"
           "   FragColor = vec4(result, 1.0);\n"
-          "}\0";
+          "}\n"
+          "#endif\0";
       } else {
         // 1.0 declare shaders
         vShaderCode = "#version 330 core\n"
           "layout (location = 0) in vec3 aPos;\n"
+          FRAME_BLOCK_GLSL
           "uniform mat4 model;\n"
-          "uniform mat4 view;\n"
-          "uniform mat4 projection;\n"
           "void main()\n"
           "{\n"
           "   gl_Position = projection * view * model * vec4(aPos, 1.0);\n"
@@ -108,14 +232,18 @@ public:
 
       // 2. compile shaders
       unsigned int vertex, fragment;
+      std::string vertexSource = withDefines(vShaderCode, defines);
+      std::string fragmentSource = withDefines(fShaderCode, defines);
+      const char *vertexCode = vertexSource.c_str();
+      const char *fragmentCode = fragmentSource.c_str();
       // vertex shader
       vertex = glCreateShader(GL_VERTEX_SHADER);
-      glShaderSource(vertex, 1, &vShaderCode, NULL);
+      glShaderSource(vertex, 1, &vertexCode, NULL);
       glCompileShader(vertex);
       checkCompileErrors(vertex, "VERTEX");
       // fragment Shader
       fragment = glCreateShader(GL_FRAGMENT_SHADER);
-      glShaderSource(fragment, 1, &fShaderCode, NULL);
+      glShaderSource(fragment, 1, &fragmentCode, NULL);
       glCompileShader(fragment);
       checkCompileErrors(fragment, "FRAGMENT");
       // shader Program
@@ -127,6 +255,35 @@ public:
       // delete the shaders as they're linked into our program now and no longer necessary
       glDeleteShader(vertex);
       glDeleteShader(fragment);
+      // 3. resolve uniforms and block bindings once instead of on every set call
+      cacheUniforms();
+      bindBlock("Frame", FRAME_BINDING);
+      bindBlock("Materials", MATERIAL_BINDING);
+      bindBlock("Draws", DRAW_BINDING);
+    }
+    // compute program from GLSL source (#version 430 or later), the caller deletes the program
+    // ------------------------------------------------------------------------
+    explicit Shader(const char *computeCode, const std::string &defines = "") : vShaderCode(NULL), fShaderCode(NULL) {
+      std::string computeSource = withDefines(computeCode, defines);
+      const char *code = computeSource.c_str();
+      unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+      glShaderSource(compute, 1, &code, NULL);
+      glCompileShader(compute);
+      checkCompileErrors(compute, "COMPUTE");
+      ID = glCreateProgram();
+      glAttachShader(ID, compute);
+      glLinkProgram(ID);
+      checkCompileErrors(ID, "PROGRAM");
+      glDeleteShader(compute);
+      cacheUniforms();
+    }
+    // whether the program linked, failures are also printed when it is built
+    // ------------------------------------------------------------------------
+    bool linked() const
+    {
+      GLint status = 0;
+      glGetProgramiv(ID, GL_LINK_STATUS, &status);
+      return status == GL_TRUE;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -134,41 +291,143 @@ public:
     { 
       glUseProgram(ID); 
     }
-    // utility uniform functions
+    // location of a uniform by name hash, -1 (ignored by glUniform*) if the program has none
+    // ------------------------------------------------------------------------
+    GLint location(uint32_t name) const
+    {
+      std::vector<std::pair<uint32_t, GLint> >::const_iterator found =
+        std::lower_bound(locations.begin(), locations.end(), std::make_pair(name, (GLint)-1));
+      return found != locations.end() && found->first == name ? found->second : -1;
+    }
+    // utility uniform functions, pass UNIFORM("name") on hot paths so the hash is a constant
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(uint32_t name, bool value) const
     {         
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+      glUniform1i(location(name), (int)value); 
+    }
+    void setBool(const char *name, bool value) const
+    {         
+      setBool(uniformHash(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(uint32_t name, int value) const
+    { 
+      glUniform1i(location(name), value); 
+    }
+    void setInt(const char *name, int value) const
     { 
-      glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+      setInt(uniformHash(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(uint32_t name, float value) const
     { 
-      glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+      glUniform1f(location(name), value); 
+    }
+    void setFloat(const char *name, float value) const
+    { 
+      setFloat(uniformHash(name), value); 
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(uint32_t name, const glm::mat4 &value) const
+    { 
+      glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void setMat4(const char *name, const glm::mat4 &value) const
+    { 
+      setMat4(uniformHash(name), value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(uint32_t name, float x, float y) const
+    { 
+      glUniform2f(location(name), x, y); 
+    }
+    void setVec2(const char *name, float x, float y) const
+    { 
+      setVec2(uniformHash(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, glm::mat4 &value) const
+    void setVec3(uint32_t name, float x, float y, float z) const
+    { 
+      glUniform3f(location(name), x, y, z); 
+    }
+    void setVec3(const char *name, float x, float y, float z) const
     { 
-      glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+      setVec3(uniformHash(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(uint32_t name, const glm::vec3 &value) const
     { 
-      glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+      glUniform3fv(location(name), 1, &value[0]); 
+    }
+    void setVec3(const char *name, const glm::vec3 &value) const
+    { 
+      setVec3(uniformHash(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, glm::vec3 &value) const
+    void setVec4(uint32_t name, const glm::vec4 &value) const
+    { 
+      glUniform4fv(location(name), 1, &value[0]); 
+    }
+    void setVec4(const char *name, const glm::vec4 &value) const
     { 
-      glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+      setVec4(uniformHash(name), value); 
     }
 
 private:
   const char* vShaderCode;
   const char* fShaderCode;
+  // (name hash, location), sorted by hash
+  std::vector<std::pair<uint32_t, GLint> > locations;
+
+  // records every active uniform outside a block, array elements under "name[i]"
+  // ------------------------------------------------------------------------
+  void cacheUniforms()
+  {
+    GLint count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+      char name[256];
+      GLsizei length = 0;
+      GLint size = 0;
+      GLenum type;
+      glGetActiveUniform(ID, i, sizeof(name), &length, &size, &type, name);
+      std::string base(name, length);
+      if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+        base.erase(base.size() - 3);
+
+      for (GLint element = 0; element < size; element++)
+      {
+        std::string uniform = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+        GLint location = glGetUniformLocation(ID, uniform.c_str());
+        if (location >= 0)
+          locations.push_back(std::make_pair(uniformHash(uniform.c_str()), location));
+        if (size > 1 && element == 0 && location >= 0)
+          locations.push_back(std::make_pair(uniformHash(base.c_str()), location));
+      }
+    }
+    std::sort(locations.begin(), locations.end());
+    for (size_t i = 1; i < locations.size(); i++)
+    {
+      if (locations[i].first == locations[i - 1].first)
+        std::cout << "WARN: uniform name hash collision in program " << ID << std::endl;
+    }
+  }
+  // ------------------------------------------------------------------------
+  void bindBlock(const char *name, unsigned int binding)
+  {
+    GLuint index = glGetUniformBlockIndex(ID, name);
+    if (index != GL_INVALID_INDEX)
+      glUniformBlockBinding(ID, index, binding);
+  }
+  // the #version directive has to stay the first line
+  // ------------------------------------------------------------------------
+  static std::string withDefines(const char *code, const std::string &defines)
+  {
+    std::string source(code);
+    size_t versionEnd = source.find('\n') + 1;
+    return source.substr(0, versionEnd) + defines + source.substr(versionEnd);
+  }
   // utility function for checking shader compilation/linking errors.
   // ------------------------------------------------------------------------
   void checkCompileErrors(unsigned int shader, std::string type)
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <texture/TextureCache.h>
+
+struct ImageLevel {
+  int width, height;
+  const unsigned char *data;
+  size_t bytes;
+  // pixel rows, or rows of 4x4 blocks for compressed levels
+  int rows;
+  size_t rowBytes;
+};
+
+// Decoded 8-bit image as returned by stb_image, or the S3TC mip chain of a cooked texture
+// mapped from <path>.ltex. Decoding touches no GL state.
+class LoadedImage {
+  public:
+    unsigned char *pixels;
+    int width, height, components;
+
+    LoadedImage();
+    ~LoadedImage();
+
+    // prefers a fresh cooked texture next to path over decoding it
+    bool load(const std::string &path);
+    // always decodes the source image with stb_image
+    bool decode(const std::string &path);
+    // maps <path>.ltex, fails if it is missing, stale or from another format version
+    bool openCache(const std::string &path);
+    // bilinear resize to newWidth x newHeight RGBA, drops any mip chain
+    void resample(int newWidth, int newHeight);
+    // box-filters the full mip chain on the CPU so it can be streamed without glGenerateMipmap
+    void buildMipChain();
+    void release();
+    GLenum format() const;
+    bool compressed() const { return mapping != NULL; }
+    // format the texture is stored in on the GPU
+    GLenum internalFormat() const;
+
+    // level 0 is the decoded image, levels 1.. exist after buildMipChain() or in the cooked file
+    unsigned int levelCount() const;
+    ImageLevel level(unsigned int index) const;
+    size_t totalBytes() const;
+
+  private:
+    void *mapping;
+    size_t mappingSize;
+    TextureCodec codec;
+    std::vector<TextureCacheLevel> cookedLevels;
+    // backs pixels after resample(), otherwise they belong to stb_image or the mapping
+    std::vector<unsigned char> ownedPixels;
+    std::vector<unsigned char> mipPixels;
+    std::vector<size_t> mipOffsets;
+
+    LoadedImage(const LoadedImage &);
+    LoadedImage &operator=(const LoadedImage &);
+};
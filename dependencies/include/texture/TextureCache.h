@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Cooked texture stored next to the source image (<image>.ltex) by luna_texcook. It holds
+// S3TC blocks for the whole mip chain, so loading skips both stb_image and mip generation.
+// Layout: header, TextureCacheLevel[levelCount], block data of every level, finest first.
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+// largest side a cooked texture may have, keeps level sizes from overflowing
+const uint32_t TEXTURE_CACHE_MAX_SIZE = 65536;
+
+// EXT_texture_compression_s3tc, not part of the core profile glad is generated for
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum TextureCodec {
+  TEXTURE_BC1 = 1, // RGB, 8 bytes per 4x4 block
+  TEXTURE_BC3 = 3  // RGBA, 16 bytes per 4x4 block
+};
+
+struct TextureCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  uint32_t codec;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levelCount;
+};
+
+struct TextureCacheLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+const char TEXTURE_CACHE_MAGIC[4] = {'L', 'T', 'E', 'X'};
+
+inline size_t blockBytes(TextureCodec codec) {
+  return codec == TEXTURE_BC1 ? 8 : 16;
+}
+
+// bytes of the blocks covering a width x height level
+inline uint64_t levelBytes(TextureCodec codec, uint32_t width, uint32_t height) {
+  return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(codec);
+}
+
+inline GLenum compressedFormat(TextureCodec codec) {
+  return codec == TEXTURE_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+inline std::string textureCachePath(const std::string &imagePath) {
+  return imagePath + ".ltex";
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <texture/Image.h>
+#include <texture/TextureCache.h>
+
+class ThreadPool;
+
+struct TextureCookStats {
+  size_t sourceBytes;   // uncompressed mip chain
+  size_t cookedBytes;   // block data of the mip chain
+  double rmse;          // per channel, level 0
+};
+
+// rgba holds the 4x4 block row by row, 4 bytes per texel
+void encodeBC1Block(const unsigned char *rgba, unsigned char *out);
+void encodeBC3Block(const unsigned char *rgba, unsigned char *out);
+void decodeBC1Block(const unsigned char *block, unsigned char *rgba);
+
+// compresses one level, rows of blocks are spread over the pool when one is given
+std::vector<unsigned char> compressLevel(const ImageLevel &level, int components, TextureCodec codec, ThreadPool *pool);
+
+// decodes imagePath, builds the mip chain and writes <imagePath>.ltex; images with alpha
+// become BC3, everything else BC1
+bool cookTexture(const std::string &imagePath, ThreadPool *pool, TextureCookStats *stats = NULL);
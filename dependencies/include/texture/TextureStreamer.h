@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <glad/glad.h>
+#include <texture/Image.h>
+
+class TextureAsset;
+
+// default per-frame upload budget, about a 1024x1024 RGBA level
+const size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+// one row of a 16384 texel wide RGBA level, about the largest texture drivers expose
+const size_t MIN_UPLOAD_BUDGET = 16384 * 4;
+// levels up to this size are uploaded at once and act as the placeholder
+const int PLACEHOLDER_SIZE = 64;
+const unsigned int STREAM_BUFFER_COUNT = 3;
+
+struct TextureStreamStats {
+  unsigned long long bytes;
+  unsigned int levels;
+  // frames skipped because the next staging buffer was still in use by the GPU
+  unsigned int stalls;
+};
+
+// Streams mip levels into textures through a ring of pixel unpack buffers, coarse levels
+// first, at most `budget` bytes per update(). A fence per buffer keeps it from being
+// rewritten while the GPU may still be reading it. GL 3.3 has no persistent mapping, so
+// each buffer is mapped unsynchronized for the copy instead; the fences make that safe.
+class TextureStreamer {
+  public:
+    explicit TextureStreamer(size_t budget = DEFAULT_UPLOAD_BUDGET);
+    ~TextureStreamer();
+
+    // GL thread only: allocates the texture, uploads the placeholder levels and queues the
+    // rest. done runs on the GL thread once the last level is uploaded and image is released.
+    void stream(const std::shared_ptr<TextureAsset> &texture, const std::shared_ptr<LoadedImage> &image,
+                const std::function<void()> &done);
+    // GL thread only, once per frame
+    void update();
+
+    size_t pending() const { return uploads.size(); }
+    size_t budget() const { return bufferSize; }
+    const TextureStreamStats &stats() const { return streamStats; }
+
+  private:
+    struct Upload {
+      std::shared_ptr<TextureAsset> texture;
+      std::shared_ptr<LoadedImage> image;
+      std::function<void()> done;
+      int level;
+      int row;
+    };
+
+    // a band of rows copied into the current staging buffer
+    struct Region {
+      std::shared_ptr<Upload> upload;
+      int level;
+      int row;
+      int rows;
+      size_t offset;
+    };
+
+    size_t bufferSize;
+    unsigned int buffers[STREAM_BUFFER_COUNT];
+    GLsync fences[STREAM_BUFFER_COUNT];
+    unsigned int current;
+    std::deque<std::shared_ptr<Upload> > uploads;
+    std::vector<Region> regions;
+    TextureStreamStats streamStats;
+
+    TextureStreamer(const TextureStreamer &);
+    TextureStreamer &operator=(const TextureStreamer &);
+};
@@ -0,0 +1,97 @@
+#include <assets/AssetRegistry.h>
+#include <assets/MeshAsset.h>
+#include <assets/TextureAsset.h>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+const char *ASSET_TYPE_NAMES[ASSET_TYPE_COUNT] = {"mesh", "texture", "shader"};
+
+}
+
+std::string canonicalAssetPath(const std::string &path) {
+  char resolved[PATH_MAX];
+  if (realpath(path.c_str(), resolved))
+    return resolved;
+  return path;
+}
+
+AssetRegistry::AssetRegistry() {
+  for (int i = 0; i < ASSET_TYPE_COUNT; i++) {
+    counts[i] = 0;
+    cpuBytes[i] = 0;
+    gpuBytes[i] = 0;
+  }
+}
+
+std::shared_ptr<MeshAsset> AssetRegistry::mesh(const std::string &path, VertexFormat format, bool &created) {
+  std::ostringstream key;
+  key << canonicalAssetPath(path) << '#' << format;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<MeshAsset> asset = meshes[key.str()].lock();
+  created = !asset;
+  if (created) {
+    asset = std::make_shared<MeshAsset>(path, format, this);
+    meshes[key.str()] = asset;
+  }
+  return asset;
+}
+
+std::shared_ptr<TextureAsset> AssetRegistry::texture(const std::string &path, bool &created) {
+  std::string key = canonicalAssetPath(path);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<TextureAsset> asset = textures[key].lock();
+  created = !asset;
+  if (created) {
+    asset = std::make_shared<TextureAsset>(path, this);
+    textures[key] = asset;
+  }
+  return asset;
+}
+
+std::shared_ptr<Shader> AssetRegistry::shader(Type type, const std::string &defines) {
+  std::ostringstream key;
+  key << type << '#' << defines;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<Shader> asset = shaders[key.str()].lock();
+  if (!asset) {
+    AssetRegistry *registry = this;
+    asset = std::shared_ptr<Shader>(new Shader(type, defines), [registry](Shader *shader) {
+      glDeleteProgram(shader->ID);
+      registry->track(ASSET_SHADER, -1, 0, 0);
+      delete shader;
+    });
+    shaders[key.str()] = asset;
+    track(ASSET_SHADER, 1, 0, 0);
+  }
+  return asset;
+}
+
+void AssetRegistry::track(AssetType type, long long count, long long cpu, long long gpu) {
+  counts[type] += count;
+  cpuBytes[type] += cpu;
+  gpuBytes[type] += gpu;
+}
+
+AssetMemory AssetRegistry::memory(AssetType type) const {
+  AssetMemory result = {counts[type].load(), cpuBytes[type].load(), gpuBytes[type].load()};
+  return result;
+}
+
+void AssetRegistry::printMemory() const {
+  std::ostringstream line;
+  line << "ASSETS:";
+  for (int i = 0; i < ASSET_TYPE_COUNT; i++) {
+    AssetMemory usage = memory(static_cast<AssetType>(i));
+    line << " " << ASSET_TYPE_NAMES[i] << " x" << usage.count
+         << " (cpu " << usage.cpuBytes / 1024 << " KB, gpu " << usage.gpuBytes / 1024 << " KB)";
+  }
+  line << "\n";
+  std::cout << line.str() << std::flush;
+}
@@ -0,0 +1,70 @@
+#include <assets/MeshAsset.h>
+#include <assets/AssetRegistry.h>
+
+MeshAsset::MeshAsset(const std::string &path, VertexFormat format, AssetRegistry *registry)
+    : path(path), format(format), VAO(0), VBO(0), EBO(0), depthVAO(0), positionVBO(0), indexType(GL_UNSIGNED_SHORT),
+      bounds(), vertexBytes(0), indexBytes(0), positionBytes(0),
+      registry(registry), gpuBytes(0) {
+    if (registry)
+        registry->track(ASSET_MESH, 1, 0, 0);
+}
+
+MeshAsset::~MeshAsset() {
+    if (VAO) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &positionVBO);
+    }
+    if (registry)
+        registry->track(ASSET_MESH, -1, 0, -gpuBytes);
+}
+
+void MeshAsset::upload(LoadedMesh &mesh) {
+    indexType = mesh.indexType();
+    quantization = mesh.quantization();
+    lods = mesh.lods();
+    bounds = mesh.bounds();
+    if (lods.empty()) {
+        MeshLod lod = {0, mesh.indexCount(), 0.0f};
+        lods.push_back(lod);
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertexBytes(), mesh.vertexData(), GL_STATIC_DRAW);
+
+    // the element buffer binding is part of the VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBytes(), mesh.indexData(), GL_STATIC_DRAW);
+
+    setupVertexAttributes(format);
+
+    // the depth pre-pass reads positions only, so they get a stream of their own
+    unsigned int vertexCount = static_cast<unsigned int>(mesh.vertexBytes() / vertexStride(format));
+    std::vector<unsigned char> positions = extractPositions(mesh.vertexData(), vertexCount, format);
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+    glBindVertexArray(depthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size(), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    setupPositionAttribute(format);
+
+    glBindVertexArray(0);
+
+    vertexBytes = mesh.vertexBytes();
+    indexBytes = mesh.indexBytes();
+    positionBytes = positions.size();
+    gpuBytes = static_cast<long long>(vertexBytes + indexBytes + positionBytes);
+    if (registry)
+        registry->track(ASSET_MESH, 0, 0, gpuBytes);
+
+    mesh.release();
+}
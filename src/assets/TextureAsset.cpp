@@ -0,0 +1,71 @@
+#include <assets/TextureAsset.h>
+#include <assets/AssetRegistry.h>
+#include <algorithm>
+#include <climits>
+
+TextureAsset::TextureAsset(const std::string &path, AssetRegistry *registry)
+    : path(path), ID(0), width(0), height(0), registry(registry), gpuBytes(0) {
+    if (registry)
+        registry->track(ASSET_TEXTURE, 1, 0, 0);
+}
+
+TextureAsset::~TextureAsset() {
+    if (ID)
+        glDeleteTextures(1, &ID);
+    if (registry)
+        registry->track(ASSET_TEXTURE, -1, 0, -gpuBytes);
+}
+
+void TextureAsset::upload(LoadedImage &image) {
+    // every level counts as placeholder, so the whole chain goes up at once
+    image.buildMipChain();
+    allocate(image, INT_MAX);
+    image.release();
+}
+
+int TextureAsset::allocate(const LoadedImage &image, int placeholderSize) {
+    glGenTextures(1, &ID);
+    if (!image.pixels)
+        return 0;
+
+    GLenum format = image.format();
+    int levels = static_cast<int>(image.levelCount());
+    width = image.width;
+    height = image.height;
+
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // the levels up to the placeholder size are cheap enough to upload from client memory
+    // straight away, the smallest one always is
+    int resident = levels - 1;
+    while (resident > 0 && std::max(image.level(resident - 1).width, image.level(resident - 1).height) <= placeholderSize)
+        resident--;
+
+    for (int i = 0; i < levels; i++) {
+        ImageLevel level = image.level(i);
+        const unsigned char *data = i >= resident ? level.data : NULL;
+        if (image.compressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image.internalFormat(), level.width, level.height, 0,
+                                   static_cast<GLsizei>(level.bytes), data);
+        else
+            glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, data);
+        gpuBytes += static_cast<long long>(level.bytes);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, resident);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (registry)
+        registry->track(ASSET_TEXTURE, 0, 0, gpuBytes);
+    return resident;
+}
+
+void TextureAsset::setBaseLevel(int level) {
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+}
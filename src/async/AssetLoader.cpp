@@ -0,0 +1,151 @@
+#include <async/AssetLoader.h>
+#include <assets/MeshAsset.h>
+#include <assets/TextureAsset.h>
+#include <mesh/MeshLoader.h>
+#include <RenderObject.h>
+#include <RenderLight.h>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+double now() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long long decodedBytes(const LoadedMesh &mesh) {
+  return static_cast<long long>(mesh.vertexBytes() + mesh.indexBytes());
+}
+
+long long decodedBytes(const LoadedImage &image) {
+  return static_cast<long long>(image.totalBytes());
+}
+
+}
+
+AssetLoader::AssetLoader(AssetRegistry &registry, size_t uploadBudget, unsigned int threadCount)
+    : registry(registry), pending(0), startTime(0.0), streamer(uploadBudget), pool(threadCount) {}
+
+void AssetLoader::loadObject(RenderObject &object, const std::string &modelPath, const std::string &texturePath) {
+  object.mesh() = loadMesh(modelPath, RenderObject::vertexFormat);
+  object.texture() = loadTexture(texturePath);
+}
+
+void AssetLoader::loadLight(RenderLight &light, const std::string &modelPath) {
+  light.mesh = loadMesh(modelPath, VERTEX_FLOAT);
+}
+
+std::shared_ptr<MeshAsset> AssetLoader::loadMesh(const std::string &modelPath, VertexFormat format) {
+  bool created;
+  std::shared_ptr<MeshAsset> asset = registry.mesh(modelPath, format, created);
+  if (!created)
+    return asset;
+
+  std::shared_ptr<Job> job = std::make_shared<Job>();
+  job->mesh = asset;
+  enqueue();
+
+  pool.submit([this, job, modelPath, format]() {
+    ::loadMesh(modelPath, job->meshData, format);
+    registry.track(ASSET_MESH, 0, decodedBytes(job->meshData), 0);
+    taskDone(job);
+  });
+  return asset;
+}
+
+std::shared_ptr<TextureAsset> AssetLoader::loadTexture(const std::string &texturePath) {
+  bool created;
+  std::shared_ptr<TextureAsset> asset = registry.texture(texturePath, created);
+  if (!created)
+    return asset;
+
+  std::shared_ptr<Job> job = std::make_shared<Job>();
+  job->texture = asset;
+  job->image = std::make_shared<LoadedImage>();
+  enqueue();
+
+  pool.submit([this, job, texturePath]() {
+    job->image->load(texturePath);
+    job->image->buildMipChain();
+    registry.track(ASSET_TEXTURE, 0, decodedBytes(*job->image), 0);
+    taskDone(job);
+  });
+  return asset;
+}
+
+void AssetLoader::enqueue() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pending == 0)
+    startTime = now();
+  pending++;
+}
+
+void AssetLoader::taskDone(const std::shared_ptr<Job> &job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    completed.push_back(job);
+  }
+  ready.notify_one();
+}
+
+size_t AssetLoader::poll() {
+  std::vector<std::shared_ptr<Job> > finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.swap(completed);
+  }
+
+  for (size_t i = 0; i < finished.size(); i++)
+    upload(*finished[i]);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  pending -= finished.size();
+  if (!finished.empty() && pending == 0) {
+    std::cout << "ASSETS: loaded in " << (now() - startTime) * 1000.0 << " ms on "
+              << pool.size() << " threads" << std::endl;
+  }
+  return pending;
+}
+
+void AssetLoader::finish() {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (pending > 0 && completed.empty())
+        ready.wait(lock);
+      if (pending == 0)
+        return;
+    }
+    poll();
+  }
+}
+
+void AssetLoader::update() {
+  poll();
+
+  if (streamer.pending() == 0)
+    return;
+  streamer.update();
+  if (streamer.pending() == 0) {
+    const TextureStreamStats &stats = streamer.stats();
+    std::cout << "ASSETS: streamed " << stats.bytes / 1024 << " KB in " << stats.levels << " mip levels, "
+              << stats.stalls << " frames waited on a busy buffer" << std::endl;
+  }
+}
+
+void AssetLoader::upload(Job &job) {
+  // the mesh frees its CPU copy as soon as the GPU owns the data
+  if (job.mesh) {
+    long long bytes = decodedBytes(job.meshData);
+    job.mesh->upload(job.meshData);
+    registry.track(ASSET_MESH, 0, -bytes, 0);
+  }
+  if (job.texture) {
+    // the decoded levels stay in memory until the streamer has uploaded the last one
+    long long bytes = decodedBytes(*job.image);
+    AssetRegistry *assets = &registry;
+    streamer.stream(job.texture, job.image, [assets, bytes]() {
+      assets->track(ASSET_TEXTURE, 0, -bytes, 0);
+    });
+  }
+}
@@ -0,0 +1,42 @@
+#include <async/FramePipeline.h>
+#include <chrono>
+
+FramePipeline::FramePipeline() : current(NULL) {
+  // runs before either thread uses the queues
+  for (size_t i = 0; i < FRAME_SNAPSHOTS; i++) {
+    snapshots[i].indirectQueue = NULL;
+    for (int j = 0; j < SHADOW_UPDATES_PER_FRAME; j++)
+      snapshots[i].shadowIndirectQueues[j] = NULL;
+    released.push(&snapshots[i]);
+  }
+}
+
+FrameSnapshot *FramePipeline::acquire() {
+  FrameSnapshot *snapshot;
+  return released.pop(snapshot) ? snapshot : NULL;
+}
+
+void FramePipeline::publish(FrameSnapshot *snapshot) {
+  published.push(snapshot);
+  {
+    // a render thread between its check and its sleep holds the mutex, so it cannot miss this
+    std::lock_guard<std::mutex> lock(sleepMutex);
+  }
+  publishedSignal.notify_one();
+}
+
+FrameSnapshot *FramePipeline::next() {
+  FrameSnapshot *oldest;
+  if (!published.pop(oldest))
+    return NULL;
+
+  if (current)
+    released.push(current);
+  current = oldest;
+  return current;
+}
+
+void FramePipeline::wait(double seconds) {
+  std::unique_lock<std::mutex> lock(sleepMutex);
+  publishedSignal.wait_for(lock, std::chrono::duration<double>(seconds), [this]() { return !published.empty(); });
+}
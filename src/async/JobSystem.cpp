@@ -0,0 +1,206 @@
+#include <async/JobSystem.h>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// the system and deque of the worker running on this thread, the creating thread uses deque 0
+thread_local const JobSystem *currentSystem = NULL;
+thread_local unsigned int currentQueue = 0;
+
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+    : jobs(new Job[MAX_FRAME_JOBS]), nextJob(0), queued(0), unfinished(0), stopping(false), stolen(0), totalJobs(0), totalStolen(0),
+      totalFrames(0) {
+  if (threadCount == 0) {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    threadCount = hardware > 1 ? hardware - 1 : 1;
+  }
+
+  queueCount = threadCount + 1;
+  queues.reset(new Queue[queueCount]);
+  workers.reserve(threadCount);
+  for (unsigned int i = 0; i < threadCount; i++)
+    workers.push_back(std::thread(&JobSystem::workerLoop, this, i + 1));
+}
+
+JobSystem::~JobSystem() {
+  reset();
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  available.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+JobId JobSystem::add(const std::function<void()> &task, std::initializer_list<JobId> after) {
+  return addJob(task, after.begin(), after.size());
+}
+
+JobId JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &body, std::initializer_list<JobId> after) {
+  grain = std::max(grain, static_cast<size_t>(1));
+  std::vector<JobId> slices;
+  for (size_t first = 0; first < count; first += grain) {
+    size_t last = std::min(count, first + grain);
+    slices.push_back(addJob([body, first, last]() { body(first, last); }, after.begin(), after.size()));
+  }
+  // the slices may already be done, the join still has to wait for the original dependencies
+  if (slices.empty())
+    return addJob(std::function<void()>(), after.begin(), after.size());
+  return addJob(std::function<void()>(), &slices[0], slices.size());
+}
+
+JobId JobSystem::addJob(const std::function<void()> &task, const JobId *after, size_t afterCount) {
+  // out of slots: finish what it depends on and run it right here
+  if (nextJob >= MAX_FRAME_JOBS) {
+    if (nextJob++ == MAX_FRAME_JOBS)
+      std::cout << "WARN: more than " << MAX_FRAME_JOBS << " jobs in one frame, running the rest inline" << std::endl;
+    for (size_t i = 0; i < afterCount; i++)
+      wait(after[i]);
+    if (task)
+      task();
+    return NO_JOB;
+  }
+
+  JobId id = nextJob++;
+  Job &job = jobs[id];
+  job.task = task;
+  job.done = false;
+  job.pending = 1;
+  job.dependents.clear();
+  unfinished++;
+  {
+    std::lock_guard<std::mutex> lock(graphMutex);
+    for (size_t i = 0; i < afterCount; i++) {
+      if (after[i] == NO_JOB || jobs[after[i]].done)
+        continue;
+      jobs[after[i]].dependents.push_back(id);
+      job.pending++;
+    }
+  }
+  if (--job.pending == 0)
+    schedule(id);
+  return id;
+}
+
+void JobSystem::schedule(JobId job) {
+  // ready jobs stay on the thread that readied them until someone steals them
+  unsigned int self = currentSystem == this ? currentQueue : 0;
+  {
+    std::lock_guard<std::mutex> lock(queues[self].mutex);
+    queues[self].jobs.push_back(job);
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    queued++;
+  }
+  available.notify_one();
+  // the creating thread may be waiting and can run it too
+  finished.notify_one();
+}
+
+bool JobSystem::runOne(unsigned int self) {
+  JobId job = NO_JOB;
+  {
+    std::lock_guard<std::mutex> lock(queues[self].mutex);
+    if (!queues[self].jobs.empty()) {
+      job = queues[self].jobs.back();
+      queues[self].jobs.pop_back();
+    }
+  }
+
+  // the oldest job of another thread, the one its owner would get to last
+  for (unsigned int i = 1; job == NO_JOB && i < queueCount; i++) {
+    Queue &victim = queues[(self + i) % queueCount];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.front();
+      victim.jobs.pop_front();
+      stolen++;
+    }
+  }
+  if (job == NO_JOB)
+    return false;
+
+  queued--;
+  if (jobs[job].task)
+    jobs[job].task();
+  finish(job);
+  return true;
+}
+
+void JobSystem::finish(JobId job) {
+  {
+    std::lock_guard<std::mutex> lock(graphMutex);
+    jobs[job].done = true;
+    std::vector<JobId> &dependents = jobs[job].dependents;
+    for (size_t i = 0; i < dependents.size(); i++) {
+      if (--jobs[dependents[i]].pending == 0)
+        schedule(dependents[i]);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    unfinished--;
+  }
+  finished.notify_all();
+}
+
+void JobSystem::wait(JobId job) {
+  if (job == NO_JOB || job >= MAX_FRAME_JOBS)
+    return;
+  while (!jobs[job].done) {
+    if (runOne(0))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    while (!jobs[job].done && queued == 0)
+      finished.wait(lock);
+  }
+}
+
+void JobSystem::reset() {
+  while (unfinished > 0) {
+    if (runOne(0))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    while (unfinished > 0 && queued == 0)
+      finished.wait(lock);
+  }
+
+  unsigned int frameJobs = static_cast<unsigned int>(std::min(static_cast<size_t>(nextJob), MAX_FRAME_JOBS));
+  // drops whatever the tasks captured
+  for (unsigned int i = 0; i < frameJobs; i++)
+    jobs[i].task = std::function<void()>();
+  nextJob = 0;
+  report(frameJobs);
+}
+
+void JobSystem::workerLoop(unsigned int self) {
+  currentSystem = this;
+  currentQueue = self;
+  for (;;) {
+    if (runOne(self))
+      continue;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    while (!stopping && queued == 0)
+      available.wait(lock);
+    if (stopping && queued == 0)
+      return;
+  }
+}
+
+void JobSystem::report(unsigned int frameJobs) {
+  totalJobs += frameJobs;
+  totalStolen += stolen.exchange(0);
+  if (++totalFrames < JOB_REPORT_FRAMES)
+    return;
+
+  std::cout << "JOBS: " << totalJobs / totalFrames << " jobs per frame on " << size() << " threads, "
+            << (totalJobs ? 100 * totalStolen / totalJobs : 0) << "% stolen (average of " << totalFrames << " frames)" << std::endl;
+  totalJobs = 0;
+  totalStolen = 0;
+  totalFrames = 0;
+}
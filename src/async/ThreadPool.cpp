@@ -0,0 +1,47 @@
+#include <async/ThreadPool.h>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false) {
+  if (threadCount == 0)
+    threadCount = std::thread::hardware_concurrency();
+  if (threadCount == 0)
+    threadCount = 1;
+
+  workers.reserve(threadCount);
+  for (unsigned int i = 0; i < threadCount; i++)
+    workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  available.notify_all();
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+}
+
+void ThreadPool::submit(const std::function<void()> &task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(task);
+  }
+  available.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!stopping && tasks.empty())
+        available.wait(lock);
+      // drain the queue before shutting down so no submitted job is lost
+      if (tasks.empty())
+        return;
+      task = tasks.front();
+      tasks.pop_front();
+    }
+    task();
+  }
+}
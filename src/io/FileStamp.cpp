@@ -0,0 +1,16 @@
+#include <io/FileStamp.h>
+#include <sys/stat.h>
+
+bool fileStamp(const std::string &path, uint64_t &size, int64_t &mtime) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return false;
+
+  size = static_cast<uint64_t>(info.st_size);
+#ifdef __APPLE__
+  mtime = static_cast<int64_t>(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+  mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+  return true;
+}
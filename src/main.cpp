@@ -8,32 +8,83 @@
 #include <shaders/shader.h>
 #include <camera/Camera.h>
 #include <RenderObject.h>
+#include <SceneWorld.h>
 #include <RenderLight.h>
+#include <MaterialBatch.h>
+#include <RenderQueue.h>
+#include <InstanceBuffer.h>
+#include <GeometryArena.h>
+#include <IndirectQueue.h>
+#include <SceneCuller.h>
+#include <OcclusionCuller.h>
+#include <GpuCuller.h>
+#include <DepthPrepass.h>
+#include <ClusteredLights.h>
+#include <ShadowCascades.h>
+#include <assets/AssetRegistry.h>
+#include <async/AssetLoader.h>
+#include <async/JobSystem.h>
+#include <async/FramePipeline.h>
 
 #include "glm/fwd.hpp"
-#include "tinyobjloader/tiny_obj_loader.h"
 
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
-unsigned int loadTexture(char const *path);
-std::vector<float> loadObjModel(const std::string &path);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// draw every object from one texture array and material buffer, see MaterialBatch
+const bool MATERIAL_BATCHING = true;
+// draw batched objects from one shared vertex/index arena, see IndirectQueue
+const bool INDIRECT_DRAWING = true;
+// hide objects behind the terrain and rocks with a software depth buffer, see OcclusionCuller
+const bool OCCLUSION_CULLING = true;
+// cull and compact arena instances in a compute shader on GL 4.3+, see GpuCuller
+const bool GPU_CULLING = true;
+// lay down depth before shading, see DepthPrepass; P toggles it at runtime
+const bool DEPTH_PREPASS = false;
+// lanterns along the bridge as point lights culled into view clusters, see ClusteredLights
+const bool CLUSTERED_LIGHTING = true;
+const int LANTERNS_PER_SIDE = 8;
+const glm::vec3 LANTERN_COLOR(1.0f, 0.65f, 0.3f);
+// lanterns animated per job
+const size_t LANTERNS_PER_JOB = 256;
+// sun shadows from cascades that are only redrawn when they go stale, see ShadowCascades
+const bool CASCADED_SHADOWS = true;
+// radians per second the sun orbits the islands at
+const float SUN_ORBIT_SPEED = 1.4f;
+// islands per side of the archipelago, every copy of an island piece is one instanced draw
+const int ARCHIPELAGO_SIZE = 1;
+const float ISLAND_SPACING = 5.0f;
+// every island's tree is drawn on its own, the crown hangs below the trunk and sways around
+// its base by up to this many radians
+const float CROWN_SWAY_ANGLE = 0.04f;
+const float CROWN_SWAY_SPEED = 1.3f;
+// longest the input thread sleeps between event checks while the render thread is behind
+const double INPUT_WAIT_SECONDS = 0.001;
+// longest the render thread sleeps waiting for a snapshot before it checks whether to stop
+const double RENDER_WAIT_SECONDS = 0.05;
 
 Camera camera(glm::vec3(4.7f, 2.6f, 4.7f));
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+float viewportHeight = SCR_HEIGHT;
+
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+bool depthPrepass = DEPTH_PREPASS;
+bool prepassKeyDown = false;
+
 glm::vec3 lightPos(-1.0f, 1.2f, 0.8f);
 
 
@@ -57,6 +108,11 @@ int main() {
   glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
   glfwSetCursorPosCallback(window, mouse_callback);
 
+  // the framebuffer can be larger than the window on high-DPI displays
+  int framebufferWidth, framebufferHeight;
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+  viewportHeight = static_cast<float>(framebufferHeight);
+
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -66,130 +122,498 @@ int main() {
 
   glEnable(GL_DEPTH_TEST);
 
-  Shader objectShader(OBJECT);
-  Shader lightShader(LIGHTSOURCE);
-
-
-  RenderObject water(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/water.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/water.jpeg",
-    glm::vec3(0.5f, 0.5f, 0.5f),
-    128.0f
-  );
-
-  RenderObject dirt(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/dirt.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/dirt.jpg",
-    glm::vec3(0.3f, 0.3f, 0.3f),
-    16.0f
-  );
-
-  RenderObject grass(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/grass.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/grass.jpg",
-    glm::vec3(0.4f, 0.4f, 0.4f),
-    32.0f
-  );
-
-  RenderObject wood(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/wood.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/wood.jpeg",
-    glm::vec3(0.3f, 0.2f, 0.2f),
-    24.0f
-  );
-
-  RenderObject bridge(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/bridge.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/wood.jpeg",
-    glm::vec3(0.3f, 0.2f, 0.2f),
-    24.0f
-  );
-
-  RenderObject stone(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/stone.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/stone.jpg",
-    glm::vec3(0.1f, 0.1f, 0.1f),
-    8.0f
-  );
-
-  RenderObject leaves(
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/models/leaves.obj",
-    "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/leaves.jpg",
-    glm::vec3(0.2f, 0.3f, 0.2f),
-    16.0f
-  );
-
-
-  RenderLight sun("/Users/erikbayerlein/Documents/cg3d/src/resources/models/sun.obj");
-
-  glEnable(GL_CULL_FACE);
-
-  // shader configuration
-  // --------------------
-  objectShader.use(); 
-  objectShader.setInt("material.diffuse", 0);
-
-
-  // render loop
-  // -----------
-  while (!glfwWindowShouldClose(window)) {
-    // per-frame logic
-    // ---------------
-    float currentFrame = static_cast<float>(glfwGetTime());
-    deltaTime = currentFrame - lastFrame;
-    lastFrame = currentFrame;
-
-    // input
-    // -----
-    processInput(window);
-
-    // render
-    // ------
-    glClearColor(0.902f, 0.945f, 0.847f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Update light position based on time
-    float orbitRadius = 4.0f;
-    float orbitSpeed = glfwGetTime() * 1.4f;
-
-    float lightZ = orbitRadius * cos(orbitSpeed);
-    float lightY = orbitRadius * sin(orbitSpeed);
-    glm::vec3 lightPos = glm::vec3(0.0f, lightY, lightZ);
-
-    // be sure to activate shader when setting uniforms/drawing objects
-    objectShader.use();
-    objectShader.setVec3("light.position", lightPos);
-    objectShader.setVec3("viewPos", camera.Position);
-
-    // light properties
-    objectShader.setVec3("light.ambient", 0.2f, 0.2f, 0.2f); 
-    objectShader.setVec3("light.diffuse", 0.5f, 0.5f, 0.5f);
-    objectShader.setVec3("light.specular", 1.0f, 1.0f, 1.0f);
-
-    // view/projection transformations
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-    glm::mat4 view = camera.GetViewMatrix();
-    objectShader.setMat4("projection", projection);
-    objectShader.setMat4("view", view);
-
-    // world transformation
-    glm::mat4 model = glm::mat4(1.0f);
-    objectShader.setMat4("model", model);
-
-    water.render(objectShader);
-    dirt.render(objectShader);
-    grass.render(objectShader);
-    stone.render(objectShader);
-    wood.render(objectShader);
-    leaves.render(objectShader);
-    bridge.render(objectShader);
-
-    sun.renderSun(projection, view, lightShader);
-
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+  // the scene owns GL objects, so it has to go out of scope before the context does
+  {
+    // files used by several objects (wood.jpeg) are decoded and uploaded once
+    AssetRegistry assets;
+    std::shared_ptr<Shader> lightShaderAsset = assets.shader(LIGHTSOURCE);
+    Shader &lightShader = *lightShaderAsset;
+
+    // 16 bytes per vertex instead of 32, see mesh/VertexFormat.h
+    RenderObject::vertexFormat = VERTEX_PACKED_QUANTIZED;
+
+    // meshes and images decode on worker threads, uploads happen here in loader.finish()
+    AssetLoader loader(assets);
+
+    // transforms, meshes, materials and bounds of every object in packed arrays, the
+    // RenderObjects below are handles onto its entities
+    SceneWorld world;
+
+    RenderObject water(
+      world,
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/models/water.obj",
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/water.jpeg",
+      glm::vec3(0.5f, 0.5f, 0.5f),
+      128.0f,
+      loader
+    );
+
+    RenderObject dirt(
+      world,
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/models/dirt.obj",
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/dirt.jpg",
+      glm::vec3(0.3f, 0.3f, 0.3f),
+      16.0f,
+      loader
+    );
+
+    RenderObject grass(
+      world,
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/models/grass.obj",
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/grass.jpg",
+      glm::vec3(0.4f, 0.4f, 0.4f),
+      32.0f,
+      loader
+    );
+
+    RenderObject bridge(
+      world,
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/models/bridge.obj",
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/wood.jpeg",
+      glm::vec3(0.3f, 0.2f, 0.2f),
+      24.0f,
+      loader
+    );
+
+    RenderObject stone(
+      world,
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/models/stone.obj",
+      "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/stone.jpg",
+      glm::vec3(0.1f, 0.1f, 0.1f),
+      8.0f,
+      loader
+    );
+
+    // one trunk and crown per island, the registry loads the files once for all of them
+    std::vector<std::unique_ptr<RenderObject> > trunks, crowns;
+    for (int i = 0; i < ARCHIPELAGO_SIZE * ARCHIPELAGO_SIZE; i++) {
+      trunks.push_back(std::unique_ptr<RenderObject>(new RenderObject(
+        world,
+        "/Users/erikbayerlein/Documents/cg3d/src/resources/models/wood.obj",
+        "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/wood.jpeg",
+        glm::vec3(0.3f, 0.2f, 0.2f),
+        24.0f,
+        loader
+      )));
+      crowns.push_back(std::unique_ptr<RenderObject>(new RenderObject(
+        world,
+        "/Users/erikbayerlein/Documents/cg3d/src/resources/models/leaves.obj",
+        "/Users/erikbayerlein/Documents/cg3d/src/resources/textures/leaves.jpg",
+        glm::vec3(0.2f, 0.3f, 0.2f),
+        16.0f,
+        loader
+      )));
+      crowns.back()->setParent(trunks.back().get());
     }
 
+    RenderLight sun("/Users/erikbayerlein/Documents/cg3d/src/resources/models/sun.obj", loader);
+
+    loader.finish();
+
+    MaterialBatch materials;
+    std::vector<RenderObject*> sceneObjects = {&water, &dirt, &grass, &stone, &bridge};
+
+    // the island pieces share one transform list, so they always move together
+    std::shared_ptr<InstanceBuffer> islands = std::make_shared<InstanceBuffer>();
+    for (int x = 0; x < ARCHIPELAGO_SIZE; x++) {
+      for (int z = 0; z < ARCHIPELAGO_SIZE; z++) {
+        glm::vec3 offset = ISLAND_SPACING * glm::vec3(x - (ARCHIPELAGO_SIZE - 1) * 0.5f, 0.0f, z - (ARCHIPELAGO_SIZE - 1) * 0.5f);
+        islands->add(glm::translate(glm::mat4(1.0f), offset));
+      }
+    }
+    for (size_t i = 0; i < sceneObjects.size(); i++)
+      sceneObjects[i]->instances() = islands;
+    // the trees stand where their island does, the crowns follow their trunk
+    for (size_t i = 0; i < trunks.size(); i++) {
+      trunks[i]->setTransform(islands->get(i));
+      sceneObjects.push_back(trunks[i].get());
+      sceneObjects.push_back(crowns[i].get());
+    }
+    // the crowns sway around the middle of their lowest point
+    glm::vec3 crownBase(0.0f);
+    if (!crowns.empty() && crowns[0]->mesh() && crowns[0]->mesh()->ready()) {
+      const MeshBounds &bounds = crowns[0]->mesh()->bounds;
+      crownBase = glm::vec3(bounds.center.x, bounds.min.y, bounds.center.z);
+    }
+    // final transforms and bounds before the cullers copy them, only entities that move later
+    // are updated per step
+    world.updateTransforms();
+    world.updateBounds();
+    bool batched = MATERIAL_BATCHING && materials.build(sceneObjects);
+
+    GeometryArena arena;
+    bool indirect = INDIRECT_DRAWING && batched && arena.build(sceneObjects);
+
+    std::string objectDefines = batched ? MaterialBatch::shaderDefines() : "";
+    if (CLUSTERED_LIGHTING)
+      objectDefines += ClusteredLights::shaderDefines();
+    if (CASCADED_SHADOWS)
+      objectDefines += ShadowCascades::shaderDefines();
+    std::shared_ptr<Shader> objectShaderAsset = assets.shader(OBJECT, objectDefines);
+    Shader &objectShader = *objectShaderAsset;
+    // objects outside the arena keep using objectShader
+    std::shared_ptr<Shader> indirectShaderAsset = indirect ? assets.shader(OBJECT, objectDefines + IndirectQueue::shaderDefines()) : objectShaderAsset;
+    Shader &indirectShader = *indirectShaderAsset;
+    // positions-only variants of both for the depth pre-pass
+    std::shared_ptr<Shader> objectDepthShaderAsset = assets.shader(OBJECT, DepthPrepass::shaderDefines());
+    Shader &objectDepthShader = *objectDepthShaderAsset;
+    std::shared_ptr<Shader> indirectDepthShaderAsset = indirect ? assets.shader(OBJECT, IndirectQueue::shaderDefines() + DepthPrepass::shaderDefines()) : objectDepthShaderAsset;
+    Shader &indirectDepthShader = *indirectDepthShaderAsset;
+
+    assets.printMemory();
+
+    // world-space bounds of every instance of the world's entities, tested against the
+    // frustum each frame
+    SceneCuller culler;
+    culler.build(world);
+    // the same per instance for the shadow cascades, without occlusion since the camera's
+    // depth says nothing about what the sun sees
+    SceneCuller shadowCuller("SHADOW CULL");
+    if (CASCADED_SHADOWS)
+      shadowCuller.build(world);
+
+    // the ground and the rocks are large and solid enough to hide what is behind them
+    OcclusionCuller occlusion;
+    if (OCCLUSION_CULLING) {
+      occlusion.addOccluder(dirt);
+      occlusion.addOccluder(stone);
+      culler.setOcclusion(&occlusion);
+    }
+
+    // replaces both CPU cullers and the indirect queue where the context has compute shaders
+    GpuCuller gpuCuller(arena);
+    bool gpuCulling = GPU_CULLING && indirect && gpuCuller.init((GLADloadproc)glfwGetProcAddress) && gpuCuller.build(sceneObjects);
+
+    DepthPrepass prepass(depthPrepass);
+
+    ShadowCascades shadows(SUN_ORBIT_SPEED);
+    if (CASCADED_SHADOWS)
+      shadows.init();
+
+    // a row of lanterns on both edges of every island's bridge, along its longer side
+    ClusteredLights lights;
+    if (CLUSTERED_LIGHTING && bridge.mesh() && bridge.mesh()->ready()) {
+      const MeshBounds &bounds = bridge.mesh()->bounds;
+      glm::vec3 extent = bounds.max - bounds.min;
+      int along = extent.x >= extent.z ? 0 : 2, across = 2 - along;
+      for (size_t island = 0; island < islands->size(); island++) {
+        for (int side = 0; side < 2; side++) {
+          for (int i = 0; i < LANTERNS_PER_SIDE; i++) {
+            glm::vec3 position(0.0f, bounds.max.y + 0.15f, 0.0f);
+            position[along] = bounds.min[along] + extent[along] * (i + 0.5f) / LANTERNS_PER_SIDE;
+            position[across] = side ? bounds.max[across] : bounds.min[across];
+            PointLight lantern = {glm::vec3(islands->get(island) * glm::vec4(position, 1.0f)), 0.8f, LANTERN_COLOR};
+            lights.add(lantern);
+          }
+        }
+      }
+    }
+
+    glEnable(GL_CULL_FACE);
+
+    // shader configuration
+    // --------------------
+    objectShader.use(); 
+    if (!batched)
+      objectShader.setInt("material.diffuse", 0);
+
+    UniformBuffer frameUniforms(sizeof(FrameUniforms), FRAME_BINDING);
+
+    // the render thread draws the snapshots this thread publishes after every input step
+    FramePipeline pipeline;
+    std::atomic<bool> running(true);
+    // every snapshot has its own indirect queues, filled here and drawn there
+    std::unique_ptr<IndirectQueue> indirectQueues[FRAME_SNAPSHOTS];
+    std::unique_ptr<IndirectQueue> shadowIndirectQueues[FRAME_SNAPSHOTS][SHADOW_UPDATES_PER_FRAME];
+    for (size_t i = 0; i < FRAME_SNAPSHOTS; i++) {
+      indirectQueues[i].reset(new IndirectQueue(arena));
+      if (indirect)
+        indirectQueues[i]->loadMultiDraw((GLADloadproc)glfwGetProcAddress);
+      pipeline.snapshot(i).indirectQueue = indirectQueues[i].get();
+      for (int j = 0; j < SHADOW_UPDATES_PER_FRAME; j++) {
+        shadowIndirectQueues[i][j].reset(new IndirectQueue(arena));
+        if (indirect)
+          shadowIndirectQueues[i][j]->loadMultiDraw((GLADloadproc)glfwGetProcAddress);
+        pipeline.snapshot(i).shadowIndirectQueues[j] = shadowIndirectQueues[i][j].get();
+      }
+    }
+
+    // animation, culling, LOD selection, sort keys, shadow scheduling and light assignment
+    // run on every core, this thread publishes the step once the jobs are done
+    JobSystem jobs;
+
+    // the context moves to the render thread until the scene is torn down
+    glfwMakeContextCurrent(NULL);
+    std::thread renderer([&]() {
+      glfwMakeContextCurrent(window);
+
+      // size of the default framebuffer the viewport was last set for
+      int surfaceWidth = framebufferWidth, surfaceHeight = framebufferHeight;
+
+      // render loop
+      // -----------
+      // GL calls only, everything they need comes with the snapshot
+      while (running) {
+        FrameSnapshot *snapshot = pipeline.next();
+        if (!snapshot) {
+          pipeline.wait(RENDER_WAIT_SECONDS);
+          continue;
+        }
+        // the input thread simulates the next step while this one is drawn
+        glfwPostEmptyEvent();
+
+        const RenderView &renderView = snapshot->view;
+        const FrameUniforms &frame = snapshot->uniforms;
+        if (snapshot->framebufferWidth != surfaceWidth || snapshot->framebufferHeight != surfaceHeight) {
+          surfaceWidth = snapshot->framebufferWidth;
+          surfaceHeight = snapshot->framebufferHeight;
+          glViewport(0, 0, surfaceWidth, surfaceHeight);
+        }
+
+        // finer texture levels arrive a few MB per frame
+        loader.update();
+
+        // render
+        // ------
+        glClearColor(0.902f, 0.945f, 0.847f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // camera and light for every program in one buffer write
+        frameUniforms.update(&frame);
+
+        if (CLUSTERED_LIGHTING)
+          lights.upload(snapshot->lights);
+
+        if (CASCADED_SHADOWS) {
+          const ShadowFrame &shadowMaps = snapshot->shadows;
+          for (int i = 0; i < shadowMaps.updates; i++) {
+            int cascade = shadowMaps.cascades[i];
+            FrameUniforms shadowFrame = frame;
+            shadowFrame.view = shadowMaps.views[cascade];
+            shadowFrame.projection = shadowMaps.projections[cascade];
+            frameUniforms.update(&shadowFrame);
+            shadows.begin(cascade);
+            if (indirect)
+              snapshot->shadowIndirectQueues[i]->flushDepth(indirectDepthShader);
+            snapshot->shadowQueues[i].flushDepth(objectDepthShader);
+            shadows.end(surfaceWidth, surfaceHeight);
+          }
+          if (shadowMaps.updates)
+            frameUniforms.update(&frame);
+        }
+
+        // be sure to activate shader when setting uniforms/drawing objects
+        objectShader.use();
+        if (batched)
+          materials.bind(objectShader);
+        if (CLUSTERED_LIGHTING)
+          lights.bind(objectShader);
+        if (CASCADED_SHADOWS)
+          shadows.bind(objectShader, snapshot->shadows);
+        if (indirect) {
+          indirectShader.use();
+          materials.bind(indirectShader);
+          if (CLUSTERED_LIGHTING)
+            lights.bind(indirectShader);
+          if (CASCADED_SHADOWS)
+            shadows.bind(indirectShader, snapshot->shadows);
+        }
+
+        // arena objects go out in one call where the context allows it, the rest is
+        // sorted by shader, material and depth before anything is drawn
+        prepass.setEnabled(snapshot->depthPrepass);
+        prepass.begin();
+        if (gpuCulling) {
+          gpuCuller.refit(snapshot->moved, snapshot->movedTransforms);
+          gpuCuller.cull(renderView);
+          if (prepass.enabled())
+            gpuCuller.drawDepth(indirectDepthShader);
+          prepass.beginShading();
+          gpuCuller.draw(indirectShader);
+        } else {
+          if (prepass.enabled()) {
+            if (indirect)
+              snapshot->indirectQueue->flushDepth(indirectDepthShader);
+            snapshot->queue.flushDepth(objectDepthShader);
+          }
+          prepass.beginShading();
+          if (indirect)
+            snapshot->indirectQueue->flush(indirectShader);
+          snapshot->queue.flush();
+        }
+        prepass.end();
+
+        // the next frame's occlusion test sees the scene without the sun
+        if (gpuCulling)
+          gpuCuller.captureDepth(surfaceWidth, surfaceHeight);
+
+        sun.renderSun(lightShader, snapshot->lightPosition());
+
+        glfwSwapBuffers(window);
+      }
+
+      glfwMakeContextCurrent(NULL);
+    });
+
+    // input loop
+    // ----------
+    while (!glfwWindowShouldClose(window)) {
+      // per-frame logic
+      // ---------------
+      float currentFrame = static_cast<float>(glfwGetTime());
+      deltaTime = currentFrame - lastFrame;
+      lastFrame = currentFrame;
+
+      // input
+      // -----
+      processInput(window);
+
+      // one step ahead of the render thread at most: until it takes the last snapshot the
+      // camera keeps following the input, and the next snapshot starts from there
+      FrameSnapshot *snapshot = pipeline.pending() ? NULL : pipeline.acquire();
+      if (!snapshot) {
+        glfwWaitEventsTimeout(INPUT_WAIT_SECONDS);
+        continue;
+      }
+
+      // Update light position based on time
+      float orbitRadius = 4.0f;
+      float orbitSpeed = currentFrame * SUN_ORBIT_SPEED;
+
+      float lightZ = orbitRadius * cos(orbitSpeed);
+      float lightY = orbitRadius * sin(orbitSpeed);
+      glm::vec3 lightPos = glm::vec3(0.0f, lightY, lightZ);
+
+      // view/projection transformations
+      glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+      glm::mat4 view = camera.GetViewMatrix();
+
+      snapshot->time = currentFrame;
+
+      FrameUniforms &frame = snapshot->uniforms;
+      frame.view = view;
+      frame.projection = projection;
+      frame.viewPosition = glm::vec4(camera.Position, 1.0f);
+      frame.lightPosition = glm::vec4(lightPos, 1.0f);
+      frame.lightAmbient = glm::vec4(0.2f, 0.2f, 0.2f, 1.0f);
+      frame.lightDiffuse = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+      frame.lightSpecular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+      RenderView &renderView = snapshot->view;
+      renderView.view = view;
+      renderView.projection = projection;
+      renderView.position = camera.Position;
+      renderView.viewportHeight = viewportHeight;
+
+      glfwGetFramebufferSize(window, &snapshot->framebufferWidth, &snapshot->framebufferHeight);
+      snapshot->depthPrepass = depthPrepass;
+
+      // the lanterns flicker, each at its own phase
+      if (CLUSTERED_LIGHTING) {
+        JobId flicker = jobs.parallelFor(lights.size(), LANTERNS_PER_JOB, [&](size_t first, size_t last) {
+          for (size_t i = first; i < last; i++)
+            lights.light(i).color = LANTERN_COLOR * (0.85f + 0.15f * sin(snapshot->time * 7.0f + i * 1.7f));
+        });
+        JobId assignment = lights.assign(jobs, renderView, snapshot->framebufferWidth, snapshot->framebufferHeight, snapshot->lights, {flicker});
+        jobs.add([&]() { lights.report(); }, {assignment});
+      }
+
+      // the crowns sway, then everything moved since the last step is updated along with what
+      // hangs below it and the culler's copy of the bounds follows
+      JobId animation = jobs.add([&]() {
+        for (size_t i = 0; i < crowns.size(); i++) {
+          float phase = snapshot->time * CROWN_SWAY_SPEED + i * 2.3f;
+          glm::mat4 sway = glm::translate(glm::mat4(1.0f), crownBase);
+          sway = glm::rotate(sway, CROWN_SWAY_ANGLE * sin(phase), glm::vec3(1.0f, 0.0f, 0.0f));
+          sway = glm::rotate(sway, CROWN_SWAY_ANGLE * cos(phase * 0.7f), glm::vec3(0.0f, 0.0f, 1.0f));
+          crowns[i]->setTransform(glm::translate(sway, -crownBase));
+        }
+        world.updateTransforms();
+
+        const std::vector<uint32_t> &moved = world.movedIndices();
+        if (CASCADED_SHADOWS)
+          shadowCuller.refit(world, moved);
+        if (!gpuCulling) {
+          culler.refit(world, moved);
+          return;
+        }
+        // the GPU culler's instances are only touched on the render thread
+        snapshot->moved = moved;
+        snapshot->movedTransforms.clear();
+        for (size_t i = 0; i < moved.size(); i++)
+          snapshot->movedTransforms.push_back(InstanceTransform(world.transforms[moved[i]], world.normalMatrices[moved[i]]));
+      });
+
+      // the visible entities of the CPU path with their LODs, sort keys and instances, the
+      // GPU path culls on the render thread
+      JobId queueing = NO_JOB;
+      if (!gpuCulling) {
+        // the occluders are drawn with the step's transforms
+        JobId occluders = OCCLUSION_CULLING ? occlusion.render(jobs, renderView, {animation}) : animation;
+        JobId culling = jobs.add([&]() {
+          culler.cull(renderView);
+          if (OCCLUSION_CULLING)
+            occlusion.report();
+        }, {animation, occluders});
+        queueing = jobs.add([&]() {
+          snapshot->queue.begin(renderView);
+          if (indirect)
+            snapshot->indirectQueue->begin(renderView);
+          for (uint32_t i = 0; i < world.size(); i++) {
+            if (!culler.visible(i))
+              continue;
+            // the queue draws every instance of an entity that is at least partly visible
+            if (!indirect || !snapshot->indirectQueue->submit(world, i, culler.visibleInstances(i)))
+              snapshot->queue.submit(world, i, objectShader);
+          }
+          snapshot->queue.sort();
+        }, {culling});
+      }
+
+      // the maps the budget allows this step, every caster drawn with the LODs the camera's
+      // queue picked so casters and the surfaces they shadow match
+      if (CASCADED_SHADOWS) {
+        jobs.add([&]() {
+          ShadowFrame &shadowMaps = snapshot->shadows;
+          shadowMaps.updates = 0;
+          for (int cascade; (cascade = shadows.schedule(renderView, -lightPos)) >= 0;) {
+            // only instances inside the cascade's box can land in its map
+            RenderView cascadeView = renderView;
+            cascadeView.view = shadows.view(cascade);
+            cascadeView.projection = shadows.projection(cascade);
+            shadowCuller.cull(cascadeView);
+
+            RenderQueue &shadowQueue = snapshot->shadowQueues[shadowMaps.updates];
+            IndirectQueue &shadowIndirectQueue = *snapshot->shadowIndirectQueues[shadowMaps.updates];
+            shadowQueue.begin(renderView);
+            if (indirect)
+              shadowIndirectQueue.begin(renderView);
+            for (uint32_t i = 0; i < world.size(); i++) {
+              if (!shadowCuller.visible(i))
+                continue;
+              if (!indirect || !shadowIndirectQueue.submit(world, i, shadowCuller.visibleInstances(i)))
+                shadowQueue.submit(world, i, objectDepthShader);
+            }
+            shadowQueue.sort();
+            shadowMaps.cascades[shadowMaps.updates++] = cascade;
+          }
+          shadows.capture(shadowMaps);
+          shadows.report();
+        }, {animation, queueing});
+      }
+
+      // the snapshot is complete once every job is
+      jobs.reset();
+
+      pipeline.publish(snapshot);
+      glfwPollEvents();
+    }
+
+    running = false;
+    renderer.join();
+    glfwMakeContextCurrent(window);
+  }
+
     glfwTerminate();
     return 0;
 }
@@ -198,6 +622,12 @@ void processInput(GLFWwindow *window) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, true);
 
+  // once per press, not once per frame the key is held
+  bool prepassKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+  if (prepassKey && !prepassKeyDown)
+    depthPrepass = !depthPrepass;
+  prepassKeyDown = prepassKey;
+
   float cameraSpeed = static_cast<float>(2.5 * deltaTime);
   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
     camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -238,6 +668,7 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
   camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
+// runs on the input thread, the render thread sets the viewport from the next snapshot
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-  glViewport(0, 0, width, height);
+  viewportHeight = static_cast<float>(height);
 }
@@ -0,0 +1,121 @@
+#include <mesh/Mesh.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct VertexKey {
+  uint32_t bits[FLOATS_PER_VERTEX];
+
+  bool operator==(const VertexKey &other) const {
+    return std::memcmp(bits, other.bits, sizeof(bits)) == 0;
+  }
+};
+
+VertexKey makeKey(const float *vertex) {
+  VertexKey key;
+  for (unsigned int i = 0; i < FLOATS_PER_VERTEX; i++) {
+    // adding zero turns -0.0 into +0.0 so both weld together
+    float value = vertex[i] + 0.0f;
+    std::memcpy(&key.bits[i], &value, sizeof(float));
+  }
+  return key;
+}
+
+uint32_t hashKey(const VertexKey &key) {
+  // FNV-1a over the raw float bits
+  uint32_t hash = 2166136261u;
+  for (unsigned int i = 0; i < FLOATS_PER_VERTEX; i++) {
+    hash ^= key.bits[i];
+    hash *= 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+}
+
+MeshData weldVertices(const std::vector<float> &soup) {
+  MeshData mesh;
+  computeBounds(mesh);
+  size_t soupCount = soup.size() / FLOATS_PER_VERTEX;
+  if (soupCount == 0)
+    return mesh;
+
+  // open addressing table sized to at least twice the worst case (no sharing at all)
+  size_t capacity = 1;
+  while (capacity < soupCount * 2)
+    capacity <<= 1;
+  const uint32_t EMPTY = 0xFFFFFFFFu;
+  std::vector<uint32_t> table(capacity, EMPTY);
+  std::vector<VertexKey> keys;
+  keys.reserve(soupCount);
+
+  mesh.vertices.reserve(soup.size());
+  mesh.indices.reserve(soupCount);
+
+  for (size_t v = 0; v < soupCount; v++) {
+    const float *vertex = &soup[v * FLOATS_PER_VERTEX];
+    VertexKey key = makeKey(vertex);
+
+    size_t slot = hashKey(key) & (capacity - 1);
+    while (table[slot] != EMPTY && !(keys[table[slot]] == key))
+      slot = (slot + 1) & (capacity - 1);
+
+    if (table[slot] == EMPTY) {
+      table[slot] = static_cast<uint32_t>(keys.size());
+      keys.push_back(key);
+      mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + FLOATS_PER_VERTEX);
+    }
+    mesh.indices.push_back(table[slot]);
+  }
+
+  mesh.vertices.shrink_to_fit();
+
+  MeshLod lod = {0, static_cast<unsigned int>(mesh.indices.size()), 0.0f};
+  mesh.lods.push_back(lod);
+  computeBounds(mesh);
+  return mesh;
+}
+
+void printWeldStats(const std::string &name, size_t soupVertexCount, const MeshData &mesh) {
+  unsigned int unique = mesh.vertexCount();
+  float ratio = unique > 0 ? static_cast<float>(soupVertexCount) / unique : 0.0f;
+  // one write per line so reports from loader threads do not interleave
+  std::ostringstream line;
+  line << "MESH: " << name << " welded " << soupVertexCount << " -> " << unique
+       << " vertices (" << ratio << "x reuse, "
+       << (mesh.indexType() == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices)\n";
+  std::cout << line.str() << std::flush;
+}
+
+void computeBounds(MeshData &mesh) {
+  unsigned int count = mesh.vertexCount();
+  if (count == 0) {
+    mesh.bounds.min = mesh.bounds.max = mesh.bounds.center = glm::vec3(0.0f);
+    mesh.bounds.radius = 0.0f;
+    return;
+  }
+
+  glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+  glm::vec3 hi = lo;
+  for (unsigned int v = 1; v < count; v++) {
+    const float *p = &mesh.vertices[static_cast<size_t>(v) * FLOATS_PER_VERTEX];
+    lo = glm::min(lo, glm::vec3(p[0], p[1], p[2]));
+    hi = glm::max(hi, glm::vec3(p[0], p[1], p[2]));
+  }
+
+  glm::vec3 center = (lo + hi) * 0.5f;
+  float radius = 0.0f;
+  for (unsigned int v = 0; v < count; v++) {
+    const float *p = &mesh.vertices[static_cast<size_t>(v) * FLOATS_PER_VERTEX];
+    radius = std::max(radius, glm::length(glm::vec3(p[0], p[1], p[2]) - center));
+  }
+
+  mesh.bounds.min = lo;
+  mesh.bounds.max = hi;
+  mesh.bounds.center = center;
+  mesh.bounds.radius = radius;
+}
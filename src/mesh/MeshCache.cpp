@@ -0,0 +1,250 @@
+#include <mesh/MeshCache.h>
+#include <io/FileStamp.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char MESH_CACHE_MAGIC[4] = {'L', 'M', 'S', 'H'};
+
+std::vector<unsigned char> packIndices(const MeshData &mesh) {
+  std::vector<unsigned char> bytes;
+  if (mesh.indexType() == GL_UNSIGNED_SHORT) {
+    bytes.resize(mesh.indices.size() * sizeof(unsigned short));
+    unsigned short *out = reinterpret_cast<unsigned short *>(bytes.data());
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+      out[i] = static_cast<unsigned short>(mesh.indices[i]);
+  } else {
+    bytes.resize(mesh.indices.size() * sizeof(unsigned int));
+    if (!bytes.empty())
+      std::memcpy(bytes.data(), mesh.indices.data(), bytes.size());
+  }
+  return bytes;
+}
+
+}
+
+LoadedMesh::LoadedMesh() : mapping(NULL), mappingSize(0), meshBounds(), vertexFormat(VERTEX_FLOAT) {
+  std::memset(&header, 0, sizeof(header));
+}
+
+LoadedMesh::~LoadedMesh() {
+  release();
+}
+
+bool LoadedMesh::openCache(const std::string &objPath) {
+  release();
+
+  uint64_t sourceSize;
+  int64_t sourceMtime;
+  if (!fileStamp(objPath, sourceSize, sourceMtime))
+    return false;
+
+  std::string path = meshCachePath(objPath);
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(MeshCacheHeader)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  MeshCacheHeader cached;
+  std::memcpy(&cached, data, sizeof(cached));
+
+  size_t indexEnd = sizeof(MeshCacheHeader)
+    + static_cast<size_t>(cached.vertexCount) * cached.floatsPerVertex * sizeof(float)
+    + static_cast<size_t>(cached.indexCount) * cached.indexSize;
+  size_t expected = indexEnd + static_cast<size_t>(cached.lodCount) * sizeof(MeshLod) + sizeof(MeshBounds);
+
+  bool valid = std::memcmp(cached.magic, MESH_CACHE_MAGIC, 4) == 0
+    && cached.version == MESH_CACHE_VERSION
+    && cached.floatsPerVertex == FLOATS_PER_VERTEX
+    && (cached.indexSize == 2 || cached.indexSize == 4)
+    && cached.sourceSize == sourceSize
+    && cached.sourceMtime == sourceMtime
+    && cached.lodCount > 0
+    && expected == size;
+
+  if (!valid) {
+    munmap(data, size);
+    return false;
+  }
+
+  // the tables follow 2-byte indices, so copy them out instead of aliasing unaligned memory
+  const char *tables = static_cast<const char *>(data) + indexEnd;
+  levels.resize(cached.lodCount);
+  std::memcpy(&levels[0], tables, cached.lodCount * sizeof(MeshLod));
+  std::memcpy(&meshBounds, tables + cached.lodCount * sizeof(MeshLod), sizeof(MeshBounds));
+
+  // draws, the occlusion readback and the arena trust the table and the indices, so a bad
+  // file must not send any of them past the buffers
+  for (size_t i = 0; i < levels.size() && valid; i++) {
+    valid = levels[i].indexOffset <= cached.indexCount
+      && levels[i].indexCount <= cached.indexCount - levels[i].indexOffset
+      && levels[i].indexCount % 3 == 0;
+  }
+  const unsigned char *indexData = static_cast<const unsigned char *>(data) + indexEnd - static_cast<size_t>(cached.indexCount) * cached.indexSize;
+  for (size_t i = 0; i < cached.indexCount && valid; i++) {
+    uint32_t index;
+    if (cached.indexSize == 2) {
+      uint16_t narrow;
+      std::memcpy(&narrow, indexData + i * sizeof(narrow), sizeof(narrow));
+      index = narrow;
+    } else {
+      std::memcpy(&index, indexData + i * sizeof(index), sizeof(index));
+    }
+    valid = index < cached.vertexCount;
+  }
+  if (!valid) {
+    levels.clear();
+    munmap(data, size);
+    return false;
+  }
+
+  mapping = data;
+  mappingSize = size;
+  header = cached;
+  return true;
+}
+
+void LoadedMesh::assign(MeshData &mesh) {
+  release();
+
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+  header.version = MESH_CACHE_VERSION;
+  header.floatsPerVertex = FLOATS_PER_VERTEX;
+  header.vertexCount = mesh.vertexCount();
+  header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+  header.indexSize = mesh.indexType() == GL_UNSIGNED_SHORT ? 2 : 4;
+  header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+  levels = mesh.lods;
+  meshBounds = mesh.bounds;
+
+  indices = packIndices(mesh);
+  vertices.swap(mesh.vertices);
+}
+
+void LoadedMesh::pack(VertexFormat format, VertexPackStats &stats) {
+  if (vertexFormat != VERTEX_FLOAT || format == VERTEX_FLOAT)
+    return;
+
+  std::vector<unsigned char> packed = packVertices(static_cast<const float *>(vertexData()), header.vertexCount,
+                                                   format, positionQuantization, stats);
+  packedVertices.swap(packed);
+  vertexFormat = format;
+  std::vector<float>().swap(vertices);
+}
+
+void LoadedMesh::release() {
+  if (mapping)
+    munmap(mapping, mappingSize);
+  mapping = NULL;
+  mappingSize = 0;
+  std::vector<float>().swap(vertices);
+  std::vector<unsigned char>().swap(indices);
+  std::vector<unsigned char>().swap(packedVertices);
+  std::vector<MeshLod>().swap(levels);
+  meshBounds = MeshBounds();
+  vertexFormat = VERTEX_FLOAT;
+  positionQuantization = VertexQuantization();
+  std::memset(&header, 0, sizeof(header));
+}
+
+const void *LoadedMesh::vertexData() const {
+  if (vertexFormat != VERTEX_FLOAT)
+    return packedVertices.empty() ? NULL : packedVertices.data();
+  if (mapping)
+    return static_cast<const char *>(mapping) + sizeof(MeshCacheHeader);
+  return vertices.empty() ? NULL : vertices.data();
+}
+
+size_t LoadedMesh::vertexBytes() const {
+  if (vertexFormat != VERTEX_FLOAT)
+    return packedVertices.size();
+  return static_cast<size_t>(header.vertexCount) * header.floatsPerVertex * sizeof(float);
+}
+
+const void *LoadedMesh::indexData() const {
+  if (mapping)
+    return static_cast<const char *>(mapping) + sizeof(MeshCacheHeader)
+      + static_cast<size_t>(header.vertexCount) * header.floatsPerVertex * sizeof(float);
+  return indices.empty() ? NULL : indices.data();
+}
+
+size_t LoadedMesh::indexBytes() const {
+  return static_cast<size_t>(header.indexCount) * header.indexSize;
+}
+
+unsigned int LoadedMesh::vertexCount() const {
+  return header.vertexCount;
+}
+
+unsigned int LoadedMesh::indexCount() const {
+  return header.indexCount;
+}
+
+GLenum LoadedMesh::indexType() const {
+  return header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::string meshCachePath(const std::string &objPath) {
+  return objPath + ".lmesh";
+}
+
+bool writeMeshCache(const std::string &objPath, const MeshData &mesh) {
+  MeshCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+  header.version = MESH_CACHE_VERSION;
+  if (!fileStamp(objPath, header.sourceSize, header.sourceMtime))
+    return false;
+  header.floatsPerVertex = FLOATS_PER_VERTEX;
+  header.vertexCount = mesh.vertexCount();
+  header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+  header.indexSize = mesh.indexType() == GL_UNSIGNED_SHORT ? 2 : 4;
+  header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+
+  std::vector<unsigned char> indexBytes = packIndices(mesh);
+
+  // write next to the final name and rename so readers never see a partial file
+  std::string path = meshCachePath(objPath);
+  std::string tmpPath = path + ".tmp";
+  FILE *file = std::fopen(tmpPath.c_str(), "wb");
+  if (!file) {
+    std::cout << "WARN: cannot write mesh cache " << path << std::endl;
+    return false;
+  }
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !mesh.vertices.empty())
+    ok = std::fwrite(mesh.vertices.data(), sizeof(float), mesh.vertices.size(), file) == mesh.vertices.size();
+  if (ok && !indexBytes.empty())
+    ok = std::fwrite(indexBytes.data(), 1, indexBytes.size(), file) == indexBytes.size();
+  if (ok && !mesh.lods.empty())
+    ok = std::fwrite(mesh.lods.data(), sizeof(MeshLod), mesh.lods.size(), file) == mesh.lods.size();
+  if (ok)
+    ok = std::fwrite(&mesh.bounds, sizeof(MeshBounds), 1, file) == 1;
+  ok = std::fclose(file) == 0 && ok;
+
+  if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::remove(tmpPath.c_str());
+    std::cout << "WARN: cannot write mesh cache " << path << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,31 @@
+#include <mesh/MeshLoader.h>
+#include <iostream>
+#include <mesh/ObjParser.h>
+#include <mesh/MeshOptimizer.h>
+#include <mesh/MeshSimplifier.h>
+
+void loadMesh(const std::string &objPath, LoadedMesh &mesh, VertexFormat format) {
+  if (!mesh.openCache(objPath)) {
+    std::vector<float> soup = loadObjModel(objPath);
+    MeshData welded = weldVertices(soup);
+    printWeldStats(objPath, soup.size() / FLOATS_PER_VERTEX, welded);
+    generateLods(welded, objPath);
+    optimizeMesh(welded, objPath);
+    writeMeshCache(objPath, welded);
+    mesh.assign(welded);
+  }
+
+  if (format != VERTEX_FLOAT) {
+    VertexPackStats stats;
+    mesh.pack(format, stats);
+    printPackStats(objPath, format, stats);
+  }
+}
+
+std::vector<float> loadObjModel(const std::string& path) {
+  std::vector<float> vertices;
+  // files load in parallel on AssetLoader's pool already, chunking one of them across
+  // threads of its own as well would oversubscribe every core
+  parseObj(path, vertices, 1);
+  return vertices;
+}
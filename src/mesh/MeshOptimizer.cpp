@@ -0,0 +1,294 @@
+#include <mesh/MeshOptimizer.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <glm/glm.hpp>
+
+namespace {
+
+// Forsyth scoring parameters, see "Linear-Speed Vertex Cache Optimisation"
+const int FORSYTH_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, unsigned int remainingValence) {
+  if (remainingValence == 0)
+    return -1.0f;
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+    }
+  }
+  return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+}
+
+glm::vec3 positionOf(const std::vector<float> &vertices, unsigned int index) {
+  const float *p = &vertices[static_cast<size_t>(index) * FLOATS_PER_VERTEX];
+  return glm::vec3(p[0], p[1], p[2]);
+}
+
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount,
+                                    unsigned int cacheSize) {
+  VertexCacheStats stats = {0.0f, 0.0f};
+  if (indices.empty() || vertexCount == 0)
+    return stats;
+
+  // FIFO cache, a vertex stays resident until cacheSize newer misses have pushed it out
+  std::vector<unsigned int> timestamps(vertexCount, 0);
+  unsigned int time = cacheSize + 1;
+  unsigned int misses = 0;
+  for (size_t i = 0; i < indices.size(); i++) {
+    unsigned int v = indices[i];
+    if (time - timestamps[v] > cacheSize) {
+      timestamps[v] = time++;
+      misses++;
+    }
+  }
+
+  stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+  stats.atvr = static_cast<float>(misses) / vertexCount;
+  return stats;
+}
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // vertex -> triangle adjacency in CSR form
+  std::vector<unsigned int> valence(vertexCount, 0);
+  for (size_t i = 0; i < indices.size(); i++)
+    valence[indices[i]]++;
+  std::vector<unsigned int> offsets(vertexCount + 1, 0);
+  for (unsigned int v = 0; v < vertexCount; v++)
+    offsets[v + 1] = offsets[v] + valence[v];
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++)
+    for (int k = 0; k < 3; k++)
+      adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+  std::vector<unsigned int> remaining(valence);
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> score(vertexCount);
+  for (unsigned int v = 0; v < vertexCount; v++)
+    score[v] = vertexScore(-1, remaining[v]);
+
+  std::vector<float> triangleScore(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  for (size_t t = 0; t < triangleCount; t++)
+    triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  std::vector<unsigned int> cache, nextCache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+  size_t bestTriangle = 0;
+  for (size_t t = 1; t < triangleCount; t++)
+    if (triangleScore[t] > triangleScore[bestTriangle])
+      bestTriangle = t;
+  size_t scanCursor = 0;
+
+  for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+    if (bestTriangle == triangleCount) {
+      // nothing in the cache touches an open triangle, continue with the next unvisited one
+      while (emitted[scanCursor])
+        scanCursor++;
+      bestTriangle = scanCursor;
+    }
+
+    emitted[bestTriangle] = true;
+    const unsigned int *tri = &indices[bestTriangle * 3];
+
+    // the new triangle's vertices move to the front of the LRU cache
+    nextCache.clear();
+    for (int k = 0; k < 3; k++) {
+      unsigned int v = tri[k];
+      output.push_back(v);
+      nextCache.push_back(v);
+
+      // drop the triangle from the vertex's live adjacency
+      unsigned int *begin = &adjacency[offsets[v]];
+      unsigned int *end = begin + remaining[v];
+      unsigned int *found = std::find(begin, end, static_cast<unsigned int>(bestTriangle));
+      std::swap(*found, *(end - 1));
+      remaining[v]--;
+    }
+    for (size_t i = 0; i < cache.size(); i++) {
+      unsigned int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2])
+        nextCache.push_back(v);
+    }
+    // evicted vertices score as uncached again, or their open triangles stay inflated
+    for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++) {
+      unsigned int v = nextCache[i];
+      cachePosition[v] = -1;
+      score[v] = vertexScore(-1, remaining[v]);
+    }
+    if (nextCache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE))
+      nextCache.resize(FORSYTH_CACHE_SIZE);
+    cache.swap(nextCache);
+
+    for (size_t i = 0; i < cache.size(); i++) {
+      unsigned int v = cache[i];
+      cachePosition[v] = static_cast<int>(i);
+      score[v] = vertexScore(static_cast<int>(i), remaining[v]);
+    }
+
+    // rescore open triangles around cached vertices and pick the best for the next step
+    bestTriangle = triangleCount;
+    float bestScore = -1.0f;
+    for (size_t i = 0; i < cache.size(); i++) {
+      unsigned int v = cache[i];
+      for (unsigned int a = 0; a < remaining[v]; a++) {
+        unsigned int t = adjacency[offsets[v] + a];
+        const unsigned int *other = &indices[t * 3];
+        float s = score[other[0]] + score[other[1]] + score[other[2]];
+        triangleScore[t] = s;
+        if (s > bestScore) {
+          bestScore = s;
+          bestTriangle = t;
+        }
+      }
+    }
+  }
+
+  indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<float> &vertices, float threshold) {
+  size_t triangleCount = indices.size() / 3;
+  unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / FLOATS_PER_VERTEX);
+  if (triangleCount < 2)
+    return;
+
+  VertexCacheStats before = analyzeVertexCache(indices, vertexCount);
+
+  // cut a new cluster wherever a triangle misses the cache on all three vertices, reordering
+  // clusters there costs almost nothing in vertex reuse
+  std::vector<size_t> clusterStarts;
+  std::vector<unsigned int> timestamps(vertexCount, 0);
+  unsigned int time = VERTEX_CACHE_SIZE + 1;
+  for (size_t t = 0; t < triangleCount; t++) {
+    int misses = 0;
+    for (int k = 0; k < 3; k++) {
+      unsigned int v = indices[t * 3 + k];
+      if (time - timestamps[v] > VERTEX_CACHE_SIZE) {
+        timestamps[v] = time++;
+        misses++;
+      }
+    }
+    if (t == 0 || misses == 3)
+      clusterStarts.push_back(t);
+  }
+  clusterStarts.push_back(triangleCount);
+
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  std::vector<glm::vec3> clusterCentroid(clusterStarts.size() - 1, glm::vec3(0.0f));
+  std::vector<glm::vec3> clusterNormal(clusterStarts.size() - 1, glm::vec3(0.0f));
+  for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+    float area = 0.0f;
+    for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+      glm::vec3 a = positionOf(vertices, indices[t * 3]);
+      glm::vec3 b = positionOf(vertices, indices[t * 3 + 1]);
+      glm::vec3 d = positionOf(vertices, indices[t * 3 + 2]);
+      glm::vec3 normal = glm::cross(b - a, d - a);
+      float triangleArea = glm::length(normal);
+      clusterCentroid[c] += (a + b + d) * (triangleArea / 3.0f);
+      clusterNormal[c] += normal;
+      area += triangleArea;
+    }
+    meshCentroid += clusterCentroid[c];
+    meshArea += area;
+    if (area > 0.0f)
+      clusterCentroid[c] /= area;
+  }
+  if (meshArea > 0.0f)
+    meshCentroid /= meshArea;
+
+  // clusters facing away from the mesh center are likely occluders for the rest
+  std::vector<float> key(clusterCentroid.size());
+  std::vector<size_t> order(clusterCentroid.size());
+  for (size_t c = 0; c < key.size(); c++) {
+    float length = glm::length(clusterNormal[c]);
+    glm::vec3 normal = length > 0.0f ? clusterNormal[c] / length : glm::vec3(0.0f);
+    key[c] = glm::dot(clusterCentroid[c] - meshCentroid, normal);
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&key](size_t a, size_t b) { return key[a] > key[b]; });
+
+  std::vector<unsigned int> sorted;
+  sorted.reserve(indices.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    size_t c = order[i];
+    sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+  }
+
+  VertexCacheStats after = analyzeVertexCache(sorted, vertexCount);
+  if (after.acmr <= before.acmr * threshold)
+    indices.swap(sorted);
+}
+
+void optimizeVertexFetch(MeshData &mesh) {
+  unsigned int vertexCount = mesh.vertexCount();
+  const unsigned int UNUSED = 0xFFFFFFFFu;
+  std::vector<unsigned int> remap(vertexCount, UNUSED);
+  std::vector<float> vertices;
+  vertices.reserve(mesh.vertices.size());
+
+  unsigned int next = 0;
+  for (size_t i = 0; i < mesh.indices.size(); i++) {
+    unsigned int &target = remap[mesh.indices[i]];
+    if (target == UNUSED) {
+      target = next++;
+      const float *source = &mesh.vertices[static_cast<size_t>(mesh.indices[i]) * FLOATS_PER_VERTEX];
+      vertices.insert(vertices.end(), source, source + FLOATS_PER_VERTEX);
+    }
+    mesh.indices[i] = target;
+  }
+
+  // vertices no triangle references are dropped
+  mesh.vertices.swap(vertices);
+}
+
+void optimizeMesh(MeshData &mesh, const std::string &name) {
+  if (mesh.lods.empty()) {
+    MeshLod lod = {0, static_cast<unsigned int>(mesh.indices.size()), 0.0f};
+    mesh.lods.push_back(lod);
+  }
+
+  std::vector<unsigned int> lod0(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+  VertexCacheStats before = analyzeVertexCache(lod0, mesh.vertexCount());
+
+  // every LOD is its own draw, so each range is ordered on its own
+  for (size_t l = 0; l < mesh.lods.size(); l++) {
+    std::vector<unsigned int>::iterator begin = mesh.indices.begin() + mesh.lods[l].indexOffset;
+    std::vector<unsigned int> range(begin, begin + mesh.lods[l].indexCount);
+    optimizeVertexCache(range, mesh.vertexCount());
+    optimizeOverdraw(range, mesh.vertices);
+    std::copy(range.begin(), range.end(), begin);
+  }
+  // first use across all levels, LOD 0 comes first so its fetches stay linear
+  optimizeVertexFetch(mesh);
+
+  lod0.assign(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+  VertexCacheStats after = analyzeVertexCache(lod0, mesh.vertexCount());
+
+  std::ostringstream line;
+  line << "MESH: " << name << " ACMR " << before.acmr << " -> " << after.acmr
+       << ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+  std::cout << line.str() << std::flush;
+}
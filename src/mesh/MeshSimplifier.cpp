@@ -0,0 +1,374 @@
+#include <mesh/MeshSimplifier.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// boundary edges get a perpendicular plane weighted this much harder than surface planes
+const double BOUNDARY_WEIGHT = 10.0;
+// meshes below this many triangles are cheap enough to always draw at full detail
+const size_t MIN_LOD_TRIANGLES = 128;
+
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+
+  Quadric() : a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0) {}
+
+  // squared distance to the plane n.p + d = 0, scaled by weight
+  Quadric(const glm::vec3 &n, double d, double weight) {
+    a00 = weight * n.x * n.x; a01 = weight * n.x * n.y; a02 = weight * n.x * n.z;
+    a11 = weight * n.y * n.y; a12 = weight * n.y * n.z; a22 = weight * n.z * n.z;
+    b0 = weight * n.x * d; b1 = weight * n.y * d; b2 = weight * n.z * d;
+    c = weight * d * d;
+  }
+
+  Quadric &operator+=(const Quadric &o) {
+    a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+    b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+    return *this;
+  }
+
+  double evaluate(const glm::vec3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + a11 * y * y + 2 * a12 * y * z + a22 * z * z
+         + 2 * (b0 * x + b1 * y + b2 * z) + c;
+  }
+};
+
+struct Collapse {
+  unsigned int from;
+  unsigned int to;
+  double cost;
+
+  bool operator<(const Collapse &other) const { return cost < other.cost; }
+};
+
+glm::vec3 vertexPosition(const std::vector<float> &vertices, unsigned int v) {
+  const float *p = &vertices[static_cast<size_t>(v) * FLOATS_PER_VERTEX];
+  return glm::vec3(p[0], p[1], p[2]);
+}
+
+// attribute distance used to pick which vertex at the target position replaces a collapsed one
+float attributeDistance(const std::vector<float> &vertices, unsigned int a, unsigned int b) {
+  const float *pa = &vertices[static_cast<size_t>(a) * FLOATS_PER_VERTEX];
+  const float *pb = &vertices[static_cast<size_t>(b) * FLOATS_PER_VERTEX];
+  float distance = 0.0f;
+  for (unsigned int i = 3; i < FLOATS_PER_VERTEX; i++)
+    distance += (pa[i] - pb[i]) * (pa[i] - pb[i]);
+  return distance;
+}
+
+// distance from p to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+float triangleDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+  glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+  float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+  if (d1 <= 0.0f && d2 <= 0.0f)
+    return glm::length(ap);
+  glm::vec3 bp = p - b;
+  float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+  if (d3 >= 0.0f && d4 <= d3)
+    return glm::length(bp);
+  float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    return glm::length(ap - ab * (d1 / (d1 - d3)));
+  glm::vec3 cp = p - c;
+  float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+  if (d6 >= 0.0f && d5 <= d6)
+    return glm::length(cp);
+  float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    return glm::length(ap - ac * (d2 / (d2 - d6)));
+  float va = d3 * d6 - d5 * d4;
+  if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    return glm::length(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+  float denominator = 1.0f / (va + vb + vc);
+  return glm::length(ap - ab * (vb * denominator) - ac * (vc * denominator));
+}
+
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<float> &vertices, const std::vector<unsigned int> &indices,
+                                       size_t targetIndexCount, float &error) {
+  error = 0.0f;
+  unsigned int vertexCount = static_cast<unsigned int>(vertices.size() / FLOATS_PER_VERTEX);
+  std::vector<unsigned int> result(indices);
+  if (result.size() <= targetIndexCount || vertexCount == 0)
+    return result;
+
+  // vertices at the same position share one id so the collapse sees the real topology
+  std::vector<unsigned int> positionId(vertexCount);
+  std::vector<glm::vec3> positions;
+  {
+    std::vector<unsigned int> order(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+      order[v] = v;
+    std::sort(order.begin(), order.end(), [&vertices](unsigned int a, unsigned int b) {
+      const float *pa = &vertices[static_cast<size_t>(a) * FLOATS_PER_VERTEX];
+      const float *pb = &vertices[static_cast<size_t>(b) * FLOATS_PER_VERTEX];
+      return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+    });
+    for (unsigned int i = 0; i < vertexCount; i++) {
+      glm::vec3 p = vertexPosition(vertices, order[i]);
+      if (positions.empty() || !(positions.back() == p))
+        positions.push_back(p);
+      positionId[order[i]] = static_cast<unsigned int>(positions.size() - 1);
+    }
+  }
+  unsigned int positionCount = static_cast<unsigned int>(positions.size());
+
+  // vertices grouped by position, used to pick replacements after a collapse
+  std::vector<unsigned int> groupOffsets(positionCount + 1, 0);
+  for (unsigned int v = 0; v < vertexCount; v++)
+    groupOffsets[positionId[v] + 1]++;
+  for (unsigned int p = 0; p < positionCount; p++)
+    groupOffsets[p + 1] += groupOffsets[p];
+  std::vector<unsigned int> groups(vertexCount);
+  {
+    std::vector<unsigned int> fill(groupOffsets.begin(), groupOffsets.end() - 1);
+    for (unsigned int v = 0; v < vertexCount; v++)
+      groups[fill[positionId[v]]++] = v;
+  }
+
+  // plane quadrics of every triangle plus boundary constraints
+  std::vector<Quadric> quadrics(positionCount);
+  std::vector<std::pair<uint64_t, unsigned int> > edgeUse;
+  for (size_t t = 0; t + 2 < result.size(); t += 3) {
+    unsigned int p[3] = {positionId[result[t]], positionId[result[t + 1]], positionId[result[t + 2]]};
+    glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+    float area = glm::length(normal);
+    if (area <= 0.0f)
+      continue;
+    normal /= area;
+    Quadric plane(normal, -glm::dot(normal, positions[p[0]]), area * 0.5);
+    for (int k = 0; k < 3; k++) {
+      quadrics[p[k]] += plane;
+      unsigned int a = p[k], b = p[(k + 1) % 3];
+      uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+      edgeUse.push_back(std::make_pair(key, static_cast<unsigned int>(t)));
+    }
+  }
+  std::sort(edgeUse.begin(), edgeUse.end());
+  for (size_t i = 0; i < edgeUse.size();) {
+    size_t j = i + 1;
+    while (j < edgeUse.size() && edgeUse[j].first == edgeUse[i].first)
+      j++;
+    if (j - i == 1) {
+      unsigned int a = static_cast<unsigned int>(edgeUse[i].first >> 32);
+      unsigned int b = static_cast<unsigned int>(edgeUse[i].first & 0xFFFFFFFFu);
+      size_t t = edgeUse[i].second;
+      glm::vec3 faceNormal = glm::cross(vertexPosition(vertices, result[t + 1]) - vertexPosition(vertices, result[t]),
+                                        vertexPosition(vertices, result[t + 2]) - vertexPosition(vertices, result[t]));
+      glm::vec3 edge = positions[b] - positions[a];
+      glm::vec3 normal = glm::cross(edge, faceNormal);
+      float length = glm::length(normal);
+      if (length > 0.0f) {
+        normal /= length;
+        Quadric plane(normal, -glm::dot(normal, positions[a]), BOUNDARY_WEIGHT * glm::dot(edge, edge));
+        quadrics[a] += plane;
+        quadrics[b] += plane;
+      }
+    }
+    i = j;
+  }
+
+  std::vector<unsigned int> collapsedTo(positionCount);
+  // where each input position ended up after all passes so far
+  std::vector<unsigned int> finalPosition(positionCount);
+  for (unsigned int p = 0; p < positionCount; p++)
+    finalPosition[p] = p;
+  std::vector<bool> touched(positionCount);
+  std::vector<unsigned int> triangleOffsets(positionCount + 1);
+  std::vector<unsigned int> triangles;
+  std::vector<Collapse> candidates;
+
+  while (result.size() > targetIndexCount) {
+    size_t triangleCount = result.size() / 3;
+
+    // position -> triangle adjacency of the current index list
+    std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+    for (size_t i = 0; i < result.size(); i++)
+      triangleOffsets[positionId[result[i]] + 1]++;
+    for (unsigned int p = 0; p < positionCount; p++)
+      triangleOffsets[p + 1] += triangleOffsets[p];
+    triangles.resize(result.size());
+    {
+      std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+      for (size_t i = 0; i < result.size(); i++)
+        triangles[fill[positionId[result[i]]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    // cheapest direction for every edge
+    candidates.clear();
+    for (size_t t = 0; t < triangleCount; t++) {
+      for (int k = 0; k < 3; k++) {
+        unsigned int a = positionId[result[t * 3 + k]];
+        unsigned int b = positionId[result[t * 3 + (k + 1) % 3]];
+        if (a >= b)
+          continue;
+        Quadric sum = quadrics[a];
+        sum += quadrics[b];
+        double toB = sum.evaluate(positions[b]);
+        double toA = sum.evaluate(positions[a]);
+        Collapse collapse = {toB <= toA ? a : b, toB <= toA ? b : a, std::max(0.0, std::min(toA, toB))};
+        candidates.push_back(collapse);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (unsigned int p = 0; p < positionCount; p++)
+      collapsedTo[p] = p;
+    std::fill(touched.begin(), touched.end(), false);
+
+    // each collapse removes about two triangles, stop the pass once that reaches the target
+    size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+    size_t removed = 0;
+    for (size_t i = 0; i < candidates.size() && removed < trianglesToRemove; i++) {
+      const Collapse &collapse = candidates[i];
+      if (touched[collapse.from] || touched[collapse.to])
+        continue;
+
+      // reject collapses that would flip a surviving triangle around the moved position
+      bool flips = false;
+      unsigned int dying = 0;
+      for (unsigned int a = triangleOffsets[collapse.from]; a < triangleOffsets[collapse.from + 1] && !flips; a++) {
+        const unsigned int *tri = &result[triangles[a] * 3];
+        glm::vec3 before[3], after[3];
+        bool degenerate = false;
+        for (int k = 0; k < 3; k++) {
+          unsigned int p = positionId[tri[k]];
+          degenerate = degenerate || p == collapse.to;
+          before[k] = positions[p];
+          after[k] = p == collapse.from ? positions[collapse.to] : positions[p];
+        }
+        if (degenerate) {
+          dying++;
+          continue;
+        }
+        glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+        flips = glm::dot(n0, n1) <= 0.0f;
+      }
+      if (flips)
+        continue;
+
+      collapsedTo[collapse.from] = collapse.to;
+      quadrics[collapse.to] += quadrics[collapse.from];
+      removed += dying;
+
+      // the neighbourhood's adjacency is stale now, leave it alone until the next pass
+      touched[collapse.from] = touched[collapse.to] = true;
+      for (unsigned int a = triangleOffsets[collapse.from]; a < triangleOffsets[collapse.from + 1]; a++) {
+        const unsigned int *tri = &result[triangles[a] * 3];
+        for (int k = 0; k < 3; k++)
+          touched[positionId[tri[k]]] = true;
+      }
+    }
+
+    if (removed == 0)
+      break;
+    // a target is never collapsed in the same pass, so one step follows the chain
+    for (unsigned int p = 0; p < positionCount; p++)
+      finalPosition[p] = collapsedTo[finalPosition[p]];
+
+    // move collapsed corners onto the closest matching vertex at the target position
+    std::vector<unsigned int> next;
+    next.reserve(result.size());
+    for (size_t t = 0; t < triangleCount; t++) {
+      unsigned int corner[3];
+      for (int k = 0; k < 3; k++) {
+        unsigned int v = result[t * 3 + k];
+        unsigned int target = collapsedTo[positionId[v]];
+        if (target != positionId[v]) {
+          unsigned int best = groups[groupOffsets[target]];
+          float bestDistance = attributeDistance(vertices, v, best);
+          for (unsigned int g = groupOffsets[target] + 1; g < groupOffsets[target + 1]; g++) {
+            float distance = attributeDistance(vertices, v, groups[g]);
+            if (distance < bestDistance) {
+              bestDistance = distance;
+              best = groups[g];
+            }
+          }
+          v = best;
+        }
+        corner[k] = v;
+      }
+      if (positionId[corner[0]] == positionId[corner[1]] || positionId[corner[1]] == positionId[corner[2]] ||
+          positionId[corner[0]] == positionId[corner[2]])
+        continue;
+      next.insert(next.end(), corner, corner + 3);
+    }
+    result.swap(next);
+  }
+
+  // the quadric costs are area weighted, so measure the distance itself. Collapses move onto
+  // existing vertices, which stay on the input surface; what leaves it is the simplified
+  // surface around each removed position, measured from there to the triangles of its target.
+  std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+  for (size_t i = 0; i < result.size(); i++)
+    triangleOffsets[positionId[result[i]] + 1]++;
+  for (unsigned int p = 0; p < positionCount; p++)
+    triangleOffsets[p + 1] += triangleOffsets[p];
+  triangles.resize(result.size());
+  {
+    std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (size_t i = 0; i < result.size(); i++)
+      triangles[fill[positionId[result[i]]]++] = static_cast<unsigned int>(i / 3);
+  }
+  double maxDistance = 0.0;
+  for (unsigned int p = 0; p < positionCount; p++) {
+    unsigned int target = finalPosition[p];
+    if (target == p)
+      continue;
+    // a region that vanished entirely is off by at least the collapse itself
+    float distance = glm::length(positions[p] - positions[target]);
+    for (unsigned int a = triangleOffsets[target]; a < triangleOffsets[target + 1]; a++) {
+      const unsigned int *tri = &result[triangles[a] * 3];
+      distance = std::min(distance, triangleDistance(positions[p], positions[positionId[tri[0]]],
+                                                     positions[positionId[tri[1]]], positions[positionId[tri[2]]]));
+    }
+    maxDistance = std::max(maxDistance, static_cast<double>(distance));
+  }
+  error = static_cast<float>(maxDistance);
+  return result;
+}
+
+void generateLods(MeshData &mesh, const std::string &name) {
+  mesh.lods.clear();
+  MeshLod base = {0, static_cast<unsigned int>(mesh.indices.size()), 0.0f};
+  mesh.lods.push_back(base);
+  if (mesh.indices.size() / 3 < MIN_LOD_TRIANGLES)
+    return;
+
+  std::ostringstream line;
+  line << "MESH: " << name << " LOD triangles " << mesh.indices.size() / 3;
+
+  // every level starts from the previous one, its distance to the full mesh is at most the
+  // sum of the levels' own distances
+  std::vector<unsigned int> previous(mesh.indices);
+  size_t baseCount = previous.size();
+  float error = 0.0f;
+  for (unsigned int level = 1; level < MAX_MESH_LODS; level++) {
+    size_t target = (baseCount >> level) / 3 * 3;
+    float levelError;
+    std::vector<unsigned int> simplified = simplifyMesh(mesh.vertices, previous, target, levelError);
+    // stop once the simplifier cannot make meaningful progress
+    if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+      break;
+
+    error += levelError;
+    MeshLod lod = {static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(simplified.size()), error};
+    mesh.lods.push_back(lod);
+    line << " / " << simplified.size() / 3;
+    previous.swap(simplified);
+    mesh.indices.insert(mesh.indices.end(), previous.begin(), previous.end());
+  }
+
+  line << " (max error " << error << ")\n";
+  std::cout << line.str() << std::flush;
+}
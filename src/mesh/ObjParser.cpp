@@ -0,0 +1,407 @@
+#include <mesh/ObjParser.h>
+#include <mesh/Mesh.h>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t MIN_CHUNK_BYTES = 256 * 1024;
+const int MISSING = -1;
+
+// Corners referencing data by negative (relative) index are stored relative to the chunk's
+// first element until the chunk base offsets are known. The local index can itself be
+// negative when a face refers back into an earlier chunk.
+const int LOCAL_BIAS = -(1 << 30);
+inline int encodeLocal(int local) { return LOCAL_BIAS + local; }
+
+struct Chunk {
+  const char *begin;
+  const char *end;
+
+  std::vector<float> positions;
+  std::vector<float> texcoords;
+  std::vector<float> normals;
+  // three ints (position, texcoord, normal) per triangle corner
+  std::vector<int> corners;
+  bool failed;
+
+  size_t positionBase;
+  size_t texcoordBase;
+  size_t normalBase;
+  size_t triangleBase;
+};
+
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+inline const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && isSpace(*p))
+    p++;
+  return p;
+}
+
+inline const char *nextLine(const char *p, const char *end) {
+  const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+  return newline ? newline + 1 : end;
+}
+
+// Decimal float parser without locale or stream overhead: accumulates up to 19 significant
+// digits into an integer and applies the decimal exponent with one table multiply.
+inline const char *parseFloat(const char *p, const char *end, float &out) {
+  static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  p = skipSpaces(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  const char *start = p;
+
+  while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+      p++;
+    }
+  }
+  if (p == start) {
+    out = 0.0f;
+    return NULL;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negativeExponent = *p == '-';
+      p++;
+    }
+    int value = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+      if (value < 10000)
+        value = value * 10 + (*p - '0');
+      p++;
+    }
+    exponent += negativeExponent ? -value : value;
+  }
+
+  double result = static_cast<double>(mantissa);
+  while (exponent > 22) {
+    result *= 1e22;
+    exponent -= 22;
+  }
+  while (exponent < -22) {
+    result /= 1e22;
+    exponent += 22;
+  }
+  result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+
+  out = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+inline const char *parseInt(const char *p, const char *end, int &out) {
+  bool negative = false;
+  if (p < end && *p == '-') {
+    negative = true;
+    p++;
+  }
+  const char *start = p;
+  int value = 0;
+  while (p < end && static_cast<unsigned>(*p - '0') < 10) {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  out = negative ? -value : value;
+  return p == start ? NULL : p;
+}
+
+// OBJ indices are 1-based, negative ones count back from the newest element
+inline int resolveIndex(int raw, size_t localCount) {
+  if (raw > 0)
+    return raw - 1;
+  if (raw < 0)
+    return encodeLocal(static_cast<int>(localCount) + raw);
+  return MISSING;
+}
+
+void parseChunk(Chunk &chunk) {
+  chunk.failed = false;
+  const char *p = chunk.begin;
+  const char *end = chunk.end;
+
+  // a rough guess (one record per ~30 bytes) saves most of the regrowth
+  size_t estimate = static_cast<size_t>(end - p) / 30;
+  chunk.positions.reserve(estimate * 3 / 2);
+  chunk.corners.reserve(estimate * 3);
+
+  std::vector<int> polygon;
+
+  while (p < end) {
+    p = skipSpaces(p, end);
+    const char *lineEnd = nextLine(p, end);
+
+    if (p + 1 < lineEnd && p[0] == 'v' && isSpace(p[1])) {
+      float x, y, z;
+      const char *q = parseFloat(p + 2, lineEnd, x);
+      if (q) q = parseFloat(q, lineEnd, y);
+      if (q) q = parseFloat(q, lineEnd, z);
+      if (!q) {
+        chunk.failed = true;
+        return;
+      }
+      chunk.positions.push_back(x);
+      chunk.positions.push_back(y);
+      chunk.positions.push_back(z);
+    } else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+      float x, y, z;
+      const char *q = parseFloat(p + 3, lineEnd, x);
+      if (q) q = parseFloat(q, lineEnd, y);
+      if (q) q = parseFloat(q, lineEnd, z);
+      if (!q) {
+        chunk.failed = true;
+        return;
+      }
+      chunk.normals.push_back(x);
+      chunk.normals.push_back(y);
+      chunk.normals.push_back(z);
+    } else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+      float u, v;
+      const char *q = parseFloat(p + 3, lineEnd, u);
+      if (q) q = parseFloat(q, lineEnd, v);
+      if (!q) {
+        chunk.failed = true;
+        return;
+      }
+      chunk.texcoords.push_back(u);
+      chunk.texcoords.push_back(v);
+    } else if (p + 1 < lineEnd && p[0] == 'f' && isSpace(p[1])) {
+      polygon.clear();
+      const char *q = p + 2;
+      for (;;) {
+        q = skipSpaces(q, lineEnd);
+        if (q >= lineEnd || *q == '\r' || *q == '\n' || *q == '#')
+          break;
+
+        int position = 0, texcoord = 0, normal = 0;
+        q = parseInt(q, lineEnd, position);
+        if (!q) {
+          chunk.failed = true;
+          return;
+        }
+        if (q < lineEnd && *q == '/') {
+          q++;
+          if (q < lineEnd && *q != '/') {
+            q = parseInt(q, lineEnd, texcoord);
+            if (!q) {
+              chunk.failed = true;
+              return;
+            }
+          }
+          if (q < lineEnd && *q == '/') {
+            q++;
+            q = parseInt(q, lineEnd, normal);
+            if (!q) {
+              chunk.failed = true;
+              return;
+            }
+          }
+        }
+
+        polygon.push_back(resolveIndex(position, chunk.positions.size() / 3));
+        polygon.push_back(resolveIndex(texcoord, chunk.texcoords.size() / 2));
+        polygon.push_back(resolveIndex(normal, chunk.normals.size() / 3));
+      }
+
+      // fan triangulation
+      size_t cornerCount = polygon.size() / 3;
+      for (size_t i = 1; i + 1 < cornerCount; i++) {
+        chunk.corners.insert(chunk.corners.end(), &polygon[0], &polygon[0] + 3);
+        chunk.corners.insert(chunk.corners.end(), &polygon[i * 3], &polygon[i * 3] + 6);
+      }
+    }
+
+    p = lineEnd;
+  }
+}
+
+inline const float *lookup(const std::vector<float> &data, int index, size_t base, size_t stride, size_t count) {
+  if (index == MISSING)
+    return NULL;
+  long long absolute = index >= 0 ? index : static_cast<long long>(base) + (index - LOCAL_BIAS);
+  if (absolute < 0 || absolute >= static_cast<long long>(count))
+    return NULL;
+  return &data[absolute * stride];
+}
+
+void emitChunk(const Chunk &chunk, const std::vector<float> &positions, const std::vector<float> &texcoords,
+               const std::vector<float> &normals, float *out) {
+  size_t positionCount = positions.size() / 3;
+  size_t texcoordCount = texcoords.size() / 2;
+  size_t normalCount = normals.size() / 3;
+
+  for (size_t c = 0; c < chunk.corners.size(); c += 3) {
+    const float *position = lookup(positions, chunk.corners[c], chunk.positionBase, 3, positionCount);
+    const float *texcoord = lookup(texcoords, chunk.corners[c + 1], chunk.texcoordBase, 2, texcoordCount);
+    const float *normal = lookup(normals, chunk.corners[c + 2], chunk.normalBase, 3, normalCount);
+
+    out[0] = position ? position[0] : 0.0f;
+    out[1] = position ? position[1] : 0.0f;
+    out[2] = position ? position[2] : 0.0f;
+    out[3] = normal ? normal[0] : 0.0f;
+    out[4] = normal ? normal[1] : 0.0f;
+    out[5] = normal ? normal[2] : 0.0f;
+    out[6] = texcoord ? texcoord[0] : 0.0f;
+    out[7] = texcoord ? texcoord[1] : 0.0f;
+    out += FLOATS_PER_VERTEX;
+  }
+}
+
+template <typename Fn>
+void forEachChunk(std::vector<Chunk> &chunks, Fn fn) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < chunks.size(); i++)
+    threads.push_back(std::thread(fn, std::ref(chunks[i])));
+  if (!chunks.empty())
+    fn(chunks[0]);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+}
+
+bool parseObj(const std::string &path, std::vector<float> &soup, unsigned int threadCount, ObjParseStats *stats) {
+  soup.clear();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "ERR: cannot open " << path << std::endl;
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    std::cerr << "ERR: cannot stat " << path << std::endl;
+    return false;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "ERR: cannot map " << path << std::endl;
+    return false;
+  }
+  const char *data = static_cast<const char *>(mapping);
+
+  if (threadCount == 0)
+    threadCount = std::thread::hardware_concurrency();
+  size_t chunkCount = size / MIN_CHUNK_BYTES;
+  if (chunkCount > threadCount)
+    chunkCount = threadCount;
+  if (chunkCount == 0)
+    chunkCount = 1;
+
+  // split on line boundaries so no record straddles two chunks
+  std::vector<Chunk> chunks(chunkCount);
+  const char *cursor = data;
+  const char *end = data + size;
+  for (size_t i = 0; i < chunkCount; i++) {
+    const char *chunkEnd = i + 1 == chunkCount ? end : data + size * (i + 1) / chunkCount;
+    if (chunkEnd < cursor)
+      chunkEnd = cursor;
+    if (chunkEnd < end && chunkEnd > data && chunkEnd[-1] != '\n')
+      chunkEnd = nextLine(chunkEnd, end);
+    chunks[i].begin = cursor;
+    chunks[i].end = chunkEnd;
+    cursor = chunkEnd;
+  }
+
+  forEachChunk(chunks, parseChunk);
+
+  // prefix sums give every chunk its global offsets
+  size_t positionCount = 0, texcoordCount = 0, normalCount = 0, triangleCount = 0;
+  bool failed = false;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    chunks[i].positionBase = positionCount;
+    chunks[i].texcoordBase = texcoordCount;
+    chunks[i].normalBase = normalCount;
+    chunks[i].triangleBase = triangleCount;
+    positionCount += chunks[i].positions.size() / 3;
+    texcoordCount += chunks[i].texcoords.size() / 2;
+    normalCount += chunks[i].normals.size() / 3;
+    triangleCount += chunks[i].corners.size() / 9;
+    failed = failed || chunks[i].failed;
+  }
+
+  if (failed) {
+    munmap(mapping, size);
+    std::cerr << "Failed to load/parse .obj file!" << std::endl;
+    return false;
+  }
+
+  std::vector<float> positions, texcoords, normals;
+  if (chunks.size() == 1) {
+    positions.swap(chunks[0].positions);
+    texcoords.swap(chunks[0].texcoords);
+    normals.swap(chunks[0].normals);
+  } else {
+    positions.reserve(positionCount * 3);
+    texcoords.reserve(texcoordCount * 2);
+    normals.reserve(normalCount * 3);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+      texcoords.insert(texcoords.end(), chunks[i].texcoords.begin(), chunks[i].texcoords.end());
+      normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+    }
+  }
+
+  // one allocation for the whole stream, then every chunk fills its own slice
+  soup.resize(triangleCount * 3 * FLOATS_PER_VERTEX);
+  float *out = soup.empty() ? NULL : &soup[0];
+  forEachChunk(chunks, [&](Chunk &chunk) {
+    emitChunk(chunk, positions, texcoords, normals, out + chunk.triangleBase * 3 * FLOATS_PER_VERTEX);
+  });
+
+  munmap(mapping, size);
+
+  if (stats) {
+    stats->bytes = size;
+    stats->positions = positionCount;
+    stats->triangles = triangleCount;
+    stats->chunks = static_cast<unsigned int>(chunks.size());
+  }
+  return true;
+}
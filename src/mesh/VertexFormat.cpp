@@ -0,0 +1,221 @@
+#include <mesh/VertexFormat.h>
+#include <mesh/Mesh.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  uint32_t sign = (bits >> 16) & 0x8000u;
+  int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFFu;
+
+  if (((bits >> 23) & 0xFF) == 0xFF)
+    return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+  if (exponent >= 31)
+    return static_cast<uint16_t>(sign | 0x7C00u);
+  if (exponent <= 0) {
+    if (exponent < -10)
+      return static_cast<uint16_t>(sign);
+    // subnormal half, round to nearest
+    mantissa |= 0x800000u;
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1u)
+      half++;
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  // round to nearest, ties to even; a carry into the exponent is still the correct result
+  uint32_t rest = mantissa & 0x1FFFu;
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+    half++;
+  return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t half) {
+  uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+  uint32_t exponent = (half >> 10) & 0x1Fu;
+  uint32_t mantissa = half & 0x3FFu;
+  float value;
+  if (exponent == 0)
+    value = std::ldexp(static_cast<float>(mantissa), -24);
+  else if (exponent == 31)
+    value = mantissa ? NAN : INFINITY;
+  else
+    value = std::ldexp(static_cast<float>(mantissa | 0x400u), static_cast<int>(exponent) - 25);
+
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  bits |= sign;
+  std::memcpy(&value, &bits, sizeof(bits));
+  return value;
+}
+
+int32_t snorm10(float value) {
+  if (value > 1.0f) value = 1.0f;
+  if (value < -1.0f) value = -1.0f;
+  return static_cast<int32_t>(std::floor(value * 511.0f + 0.5f));
+}
+
+uint32_t packNormal(const float *normal, glm::vec3 &decoded) {
+  int32_t x = snorm10(normal[0]);
+  int32_t y = snorm10(normal[1]);
+  int32_t z = snorm10(normal[2]);
+  decoded = glm::vec3(x / 511.0f, y / 511.0f, z / 511.0f);
+  return (static_cast<uint32_t>(x) & 0x3FFu) | ((static_cast<uint32_t>(y) & 0x3FFu) << 10) |
+         ((static_cast<uint32_t>(z) & 0x3FFu) << 20);
+}
+
+float angleDegrees(const glm::vec3 &a, const glm::vec3 &b) {
+  float la = glm::length(a), lb = glm::length(b);
+  if (la == 0.0f || lb == 0.0f)
+    return 0.0f;
+  float cosine = glm::dot(a, b) / (la * lb);
+  return glm::degrees(std::acos(glm::clamp(cosine, -1.0f, 1.0f)));
+}
+
+}
+
+unsigned int vertexStride(VertexFormat format) {
+  if (format == VERTEX_PACKED_QUANTIZED)
+    return 16;
+  if (format == VERTEX_PACKED)
+    return 20;
+  return FLOATS_PER_VERTEX * sizeof(float);
+}
+
+unsigned int positionStride(VertexFormat format) {
+  if (format == VERTEX_PACKED_QUANTIZED)
+    return 4 * sizeof(uint16_t);
+  return 3 * sizeof(float);
+}
+
+std::vector<unsigned char> packVertices(const float *vertices, unsigned int vertexCount, VertexFormat format,
+                                        VertexQuantization &quantization, VertexPackStats &stats) {
+  stats.maxPositionError = 0.0f;
+  stats.maxNormalErrorDegrees = 0.0f;
+  stats.maxUvError = 0.0f;
+  quantization = VertexQuantization();
+
+  unsigned int stride = vertexStride(format);
+  std::vector<unsigned char> packed(static_cast<size_t>(vertexCount) * stride);
+  if (format == VERTEX_FLOAT) {
+    if (!packed.empty())
+      std::memcpy(&packed[0], vertices, packed.size());
+    return packed;
+  }
+
+  if (format == VERTEX_PACKED_QUANTIZED && vertexCount > 0) {
+    glm::vec3 lo(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 hi = lo;
+    for (unsigned int v = 1; v < vertexCount; v++) {
+      const float *p = vertices + v * FLOATS_PER_VERTEX;
+      lo = glm::min(lo, glm::vec3(p[0], p[1], p[2]));
+      hi = glm::max(hi, glm::vec3(p[0], p[1], p[2]));
+    }
+    quantization.offset = lo;
+    quantization.scale = hi - lo;
+  }
+
+  for (unsigned int v = 0; v < vertexCount; v++) {
+    const float *source = vertices + v * FLOATS_PER_VERTEX;
+    unsigned char *out = &packed[static_cast<size_t>(v) * stride];
+    size_t offset;
+
+    if (format == VERTEX_PACKED_QUANTIZED) {
+      uint16_t position[4] = {0, 0, 0, 0};
+      for (int i = 0; i < 3; i++) {
+        float extent = quantization.scale[i];
+        float t = extent > 0.0f ? (source[i] - quantization.offset[i]) / extent : 0.0f;
+        position[i] = static_cast<uint16_t>(std::floor(glm::clamp(t, 0.0f, 1.0f) * 65535.0f + 0.5f));
+        float decoded = quantization.offset[i] + position[i] / 65535.0f * extent;
+        stats.maxPositionError = std::max(stats.maxPositionError, std::fabs(decoded - source[i]));
+      }
+      std::memcpy(out, position, sizeof(position));
+      offset = sizeof(position);
+    } else {
+      std::memcpy(out, source, 3 * sizeof(float));
+      offset = 3 * sizeof(float);
+    }
+
+    glm::vec3 decodedNormal;
+    uint32_t normal = packNormal(source + 3, decodedNormal);
+    std::memcpy(out + offset, &normal, sizeof(normal));
+    stats.maxNormalErrorDegrees = std::max(stats.maxNormalErrorDegrees,
+                                           angleDegrees(glm::vec3(source[3], source[4], source[5]), decodedNormal));
+    offset += sizeof(normal);
+
+    uint16_t uv[2] = {floatToHalf(source[6]), floatToHalf(source[7])};
+    std::memcpy(out + offset, uv, sizeof(uv));
+    for (int i = 0; i < 2; i++)
+      stats.maxUvError = std::max(stats.maxUvError, std::fabs(halfToFloat(uv[i]) - source[6 + i]));
+  }
+
+  return packed;
+}
+
+void printPackStats(const std::string &name, VertexFormat format, const VertexPackStats &stats) {
+  std::ostringstream line;
+  line << "MESH: " << name << " packed " << vertexStride(VERTEX_FLOAT) << " -> " << vertexStride(format)
+       << " bytes/vertex, max error position " << stats.maxPositionError
+       << " normal " << stats.maxNormalErrorDegrees << " deg uv " << stats.maxUvError << "\n";
+  std::cout << line.str() << std::flush;
+}
+
+std::vector<unsigned char> extractPositions(const void *vertices, unsigned int vertexCount, VertexFormat format) {
+  unsigned int stride = vertexStride(format), size = positionStride(format);
+  std::vector<unsigned char> positions(static_cast<size_t>(vertexCount) * size);
+  const unsigned char *source = static_cast<const unsigned char*>(vertices);
+  // every layout starts its vertex with the position
+  for (unsigned int v = 0; v < vertexCount; v++)
+    std::memcpy(&positions[static_cast<size_t>(v) * size], source + static_cast<size_t>(v) * stride, size);
+  return positions;
+}
+
+void setupVertexAttributes(VertexFormat format) {
+  GLsizei stride = static_cast<GLsizei>(vertexStride(format));
+
+  if (format == VERTEX_FLOAT) {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    return;
+  }
+
+  size_t offset;
+  if (format == VERTEX_PACKED_QUANTIZED) {
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+    offset = 4 * sizeof(uint16_t);
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    offset = 3 * sizeof(float);
+  }
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+  glEnableVertexAttribArray(1);
+
+  glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(offset + sizeof(uint32_t)));
+  glEnableVertexAttribArray(2);
+}
+
+void setupPositionAttribute(VertexFormat format) {
+  GLsizei stride = static_cast<GLsizei>(positionStride(format));
+  if (format == VERTEX_PACKED_QUANTIZED)
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+  else
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+  glEnableVertexAttribArray(0);
+}
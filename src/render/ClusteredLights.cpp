@@ -0,0 +1,270 @@
+#include <ClusteredLights.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+enum {
+  LIGHT_BUFFER,
+  RANGE_BUFFER,
+  INDEX_BUFFER
+};
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// squared distance from a point to a box, 0 inside
+float distanceSquared(const glm::vec3 &point, const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 outside = glm::max(min - point, glm::vec3(0.0f)) + glm::max(point - max, glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+}
+
+std::string ClusteredLights::shaderDefines() {
+    std::ostringstream defines;
+    defines << "#define CLUSTERED_LIGHTS\n#define CLUSTER_X " << CLUSTER_X << "\n#define CLUSTER_Y " << CLUSTER_Y
+            << "\n#define CLUSTER_Z " << CLUSTER_Z << "\n";
+    return defines.str();
+}
+
+ClusteredLights::ClusteredLights()
+    : projection(0.0f), nearPlane(0.0f), farPlane(0.0f), boxes(CLUSTER_COUNT),
+      clusterLights(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER), clusterCounts(CLUSTER_COUNT),
+      clusterParameters(0.0f), assignThreads(1), totalFrames(0) {
+    for (int i = 0; i < 3; i++) {
+        buffers[i] = 0;
+        textures[i] = 0;
+    }
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    std::memset(&totalStats, 0, sizeof(totalStats));
+}
+
+ClusteredLights::~ClusteredLights() {
+    if (buffers[0]) {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+}
+
+bool ClusteredLights::add(const PointLight &light) {
+    if (lights.size() >= MAX_POINT_LIGHTS)
+        return false;
+    lights.push_back(light);
+    return true;
+}
+
+void ClusteredLights::buildBoxes(const glm::mat4 &matrix) {
+    projection = matrix;
+    // glm::perspective: [2][2] = -(f + n) / (f - n), [3][2] = -2fn / (f - n)
+    nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    for (int z = 0; z < CLUSTER_Z; z++) {
+        float sliceNear = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / CLUSTER_Z);
+        float sliceFar = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z + 1) / CLUSTER_Z);
+        for (int y = 0; y < CLUSTER_Y; y++) {
+            for (int x = 0; x < CLUSTER_X; x++) {
+                ClusterBox &box = boxes[(z * CLUSTER_Y + y) * CLUSTER_X + x];
+                box.min = glm::vec3(1e30f);
+                box.max = glm::vec3(-1e30f);
+                // the tile's corner rays where they cross the slice's near and far depth
+                for (int corner = 0; corner < 8; corner++) {
+                    float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / CLUSTER_X;
+                    float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / CLUSTER_Y;
+                    float depth = corner & 4 ? sliceFar : sliceNear;
+                    glm::vec3 point((ndcX + projection[2][0]) * depth / projection[0][0],
+                                    (ndcY + projection[2][1]) * depth / projection[1][1], -depth);
+                    box.min = glm::min(box.min, point);
+                    box.max = glm::max(box.max, point);
+                }
+            }
+        }
+    }
+}
+
+void ClusteredLights::update(const RenderView &view, int width, int height) {
+    assignThreads = 1;
+    prepare(view, width, height, clusters);
+    assignSlices(0, CLUSTER_Z);
+    compact(clusters);
+    upload(clusters);
+}
+
+JobId ClusteredLights::assign(JobSystem &jobs, const RenderView &view, int width, int height, LightClusters &clusters,
+                              std::initializer_list<JobId> after) {
+    assignThreads = jobs.size();
+    JobId prepared = jobs.add([this, view, width, height, &clusters]() { prepare(view, width, height, clusters); }, after);
+    // bands of slices never share a cluster
+    JobId assigned = jobs.parallelFor(CLUSTER_Z, CLUSTER_SLICES_PER_JOB, [this](size_t first, size_t last) {
+        assignSlices(static_cast<int>(first), static_cast<int>(last));
+    }, {prepared});
+    return jobs.add([this, &clusters]() { compact(clusters); }, {assigned});
+}
+
+void ClusteredLights::prepare(const RenderView &view, int width, int height, LightClusters &clusters) {
+    assignStart = std::chrono::steady_clock::now();
+    if (view.projection != projection)
+        buildBoxes(view.projection);
+
+    float sliceScale = CLUSTER_Z / std::log(farPlane / nearPlane);
+    glm::vec4 &parameters = clusters.parameters;
+    parameters = glm::vec4(static_cast<float>(CLUSTER_X) / std::max(width, 1), static_cast<float>(CLUSTER_Y) / std::max(height, 1),
+                           sliceScale, -sliceScale * std::log(nearPlane));
+
+    // view-space spheres and the depth slices each can touch
+    size_t count = lights.size();
+    viewLights.resize(count);
+    firstSlice.resize(count);
+    lastSlice.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center = glm::vec3(view.view * glm::vec4(lights[i].position, 1.0f));
+        viewLights[i] = glm::vec4(center, lights[i].radius);
+        float nearest = -center.z - lights[i].radius, farthest = -center.z + lights[i].radius;
+        if (farthest < nearPlane || nearest > farPlane) {
+            firstSlice[i] = 1;
+            lastSlice[i] = 0;
+            continue;
+        }
+        firstSlice[i] = static_cast<int>(std::log(std::max(nearest, nearPlane)) * parameters.z + parameters.w);
+        lastSlice[i] = static_cast<int>(std::log(std::min(farthest, farPlane)) * parameters.z + parameters.w);
+        firstSlice[i] = std::max(0, std::min(firstSlice[i], CLUSTER_Z - 1));
+        lastSlice[i] = std::max(0, std::min(lastSlice[i], CLUSTER_Z - 1));
+    }
+}
+
+void ClusteredLights::compact(LightClusters &clusters) {
+    // the fixed-size lists into one
+    size_t count = lights.size();
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    frameStats.lights = static_cast<unsigned int>(count);
+    std::vector<bool> lit(count, false);
+    std::vector<uint32_t> &ranges = clusters.ranges;
+    std::vector<uint16_t> &indices = clusters.indices;
+    ranges.resize(CLUSTER_COUNT * 2);
+    indices.clear();
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+        int hits = clusterCounts[cluster];
+        int kept = std::min(hits, MAX_LIGHTS_PER_CLUSTER);
+        ranges[cluster * 2] = static_cast<uint32_t>(indices.size());
+        ranges[cluster * 2 + 1] = static_cast<uint32_t>(kept);
+        const uint16_t *list = &clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+        indices.insert(indices.end(), list, list + kept);
+        for (int i = 0; i < kept; i++)
+            lit[list[i]] = true;
+        frameStats.overflow += static_cast<unsigned int>(hits - kept);
+        frameStats.maxPerCluster = std::max(frameStats.maxPerCluster, static_cast<unsigned int>(hits));
+    }
+    frameStats.references = static_cast<unsigned int>(indices.size());
+    frameStats.visible = static_cast<unsigned int>(std::count(lit.begin(), lit.end(), true));
+
+    // two texels per light: position and radius, color
+    std::vector<glm::vec4> &lightTexels = clusters.lightTexels;
+    lightTexels.resize(count * 2);
+    for (size_t i = 0; i < count; i++) {
+        lightTexels[i * 2] = glm::vec4(lights[i].position, lights[i].radius);
+        lightTexels[i * 2 + 1] = glm::vec4(lights[i].color, 0.0f);
+    }
+
+    frameStats.cullMs = elapsedMs(assignStart);
+}
+
+void ClusteredLights::upload(const LightClusters &clusters) {
+    if (!buffers[0]) {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+    }
+    uploadBuffer(LIGHT_BUFFER, GL_RGBA32F, clusters.lightTexels.data(), clusters.lightTexels.size() * sizeof(glm::vec4));
+    uploadBuffer(RANGE_BUFFER, GL_RG32UI, clusters.ranges.data(), clusters.ranges.size() * sizeof(uint32_t));
+    uploadBuffer(INDEX_BUFFER, GL_R16UI, clusters.indices.data(), clusters.indices.size() * sizeof(uint16_t));
+    clusterParameters = clusters.parameters;
+}
+
+void ClusteredLights::assignSlices(int first, int last) {
+    const int sliceClusters = CLUSTER_X * CLUSTER_Y;
+    std::fill(clusterCounts.begin() + first * sliceClusters, clusterCounts.begin() + last * sliceClusters, 0);
+
+    for (size_t light = 0; light < viewLights.size(); light++) {
+        int from = std::max(first, firstSlice[light]), to = std::min(last - 1, lastSlice[light]);
+        glm::vec3 center(viewLights[light]);
+        float radiusSquared = viewLights[light].w * viewLights[light].w;
+        float radius = viewLights[light].w;
+        for (int z = from; z <= to; z++) {
+            const ClusterBox *slice = &boxes[z * sliceClusters];
+            // a cluster's x extent only depends on its column and its y extent on its row, so
+            // the columns and rows the sphere's box spans come from one pass over each
+            int x0 = 0, x1 = CLUSTER_X - 1, y0 = 0, y1 = CLUSTER_Y - 1;
+            while (x0 <= x1 && slice[x0].max.x < center.x - radius)
+                x0++;
+            while (x1 >= x0 && slice[x1].min.x > center.x + radius)
+                x1--;
+            while (y0 <= y1 && slice[y0 * CLUSTER_X].max.y < center.y - radius)
+                y0++;
+            while (y1 >= y0 && slice[y1 * CLUSTER_X].min.y > center.y + radius)
+                y1--;
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int cluster = z * sliceClusters + y * CLUSTER_X + x;
+                    if (distanceSquared(center, boxes[cluster].min, boxes[cluster].max) > radiusSquared)
+                        continue;
+                    // keeps counting past the list size so the overflow shows up in the stats
+                    int slot = clusterCounts[cluster]++;
+                    if (slot < MAX_LIGHTS_PER_CLUSTER)
+                        clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER + slot] = static_cast<uint16_t>(light);
+                }
+            }
+        }
+    }
+}
+
+void ClusteredLights::uploadBuffer(int buffer, GLenum format, const void *data, size_t bytes) {
+    // a fresh store every frame, never empty so the texture always has a buffer behind it
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, sizeof(glm::vec4)), NULL, GL_STREAM_DRAW);
+    if (bytes)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, textures[buffer]);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffers[buffer]);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLights::bind(Shader &shader) {
+    if (!buffers[0])
+        return;
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + LIGHT_TEXTURE_UNIT + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt(UNIFORM("pointLights"), LIGHT_TEXTURE_UNIT + LIGHT_BUFFER);
+    shader.setInt(UNIFORM("lightClusters"), LIGHT_TEXTURE_UNIT + RANGE_BUFFER);
+    shader.setInt(UNIFORM("lightIndices"), LIGHT_TEXTURE_UNIT + INDEX_BUFFER);
+    shader.setVec4(UNIFORM("clusterParameters"), clusterParameters);
+}
+
+void ClusteredLights::report() {
+    totalStats.lights += frameStats.lights;
+    totalStats.visible += frameStats.visible;
+    totalStats.references += frameStats.references;
+    totalStats.maxPerCluster = std::max(totalStats.maxPerCluster, frameStats.maxPerCluster);
+    totalStats.overflow += frameStats.overflow;
+    totalStats.cullMs += frameStats.cullMs;
+    if (++totalFrames < LIGHT_REPORT_FRAMES)
+        return;
+
+    std::cout << "LIGHTS: " << totalStats.visible / totalFrames << " of " << totalStats.lights / totalFrames << " point lights visible, "
+              << totalStats.references / totalFrames << " cluster entries (at most " << totalStats.maxPerCluster << " per cluster, "
+              << totalStats.overflow / totalFrames << " dropped) in " << totalStats.cullMs / totalFrames << " ms on " << assignThreads
+              << " threads" << std::endl;
+    std::memset(&totalStats, 0, sizeof(totalStats));
+    totalFrames = 0;
+}
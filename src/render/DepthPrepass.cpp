@@ -0,0 +1,87 @@
+#include <DepthPrepass.h>
+#include <iostream>
+
+std::string DepthPrepass::shaderDefines() {
+    return "#define DEPTH_ONLY\n";
+}
+
+DepthPrepass::DepthPrepass(bool enabled) : frame(0), on(enabled), totalMs(0.0), totalFrames(0) {
+    for (unsigned int i = 0; i < DEPTH_PREPASS_QUERIES; i++) {
+        queries[i] = 0;
+        pending[i] = false;
+    }
+}
+
+DepthPrepass::~DepthPrepass() {
+    if (queries[0])
+        glDeleteQueries(DEPTH_PREPASS_QUERIES, queries);
+}
+
+void DepthPrepass::setEnabled(bool enabled) {
+    if (enabled == on)
+        return;
+    on = enabled;
+
+    // frames still in flight were drawn the other way
+    for (unsigned int i = 0; i < DEPTH_PREPASS_QUERIES; i++)
+        pending[i] = false;
+    totalMs = 0.0;
+    totalFrames = 0;
+    std::cout << "PREPASS: " << (on ? "on" : "off") << std::endl;
+}
+
+void DepthPrepass::begin() {
+    if (!queries[0])
+        glGenQueries(DEPTH_PREPASS_QUERIES, queries);
+
+    unsigned int query = frame % DEPTH_PREPASS_QUERIES;
+    collect(query);
+    glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+    pending[query] = true;
+
+    if (on)
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+}
+
+void DepthPrepass::beginShading() {
+    if (!on)
+        return;
+    // every visible fragment already has its depth, equal means it is the front one
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_EQUAL);
+}
+
+void DepthPrepass::end() {
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glEndQuery(GL_TIME_ELAPSED);
+    frame++;
+    report();
+}
+
+void DepthPrepass::collect(unsigned int query) {
+    if (!pending[query])
+        return;
+    pending[query] = false;
+
+    // a result that is still not there is dropped rather than waited for
+    GLint available = 0;
+    glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &nanoseconds);
+    totalMs += nanoseconds / 1e6;
+    totalFrames++;
+}
+
+void DepthPrepass::report() {
+    if (totalFrames < DEPTH_PREPASS_REPORT_FRAMES)
+        return;
+
+    std::cout << "PREPASS: " << (on ? "on" : "off") << ", scene " << totalMs / totalFrames << " ms GPU (average of "
+              << totalFrames << " frames)" << std::endl;
+    totalMs = 0.0;
+    totalFrames = 0;
+}
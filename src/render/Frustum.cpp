@@ -0,0 +1,88 @@
+#include <Frustum.h>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4 &m) {
+    // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+    for (int i = 0; i < 6; i++)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const {
+    for (int i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+FrustumTest Frustum::testBox(const glm::vec3 &min, const glm::vec3 &max) const {
+    FrustumTest result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; i++) {
+        glm::vec3 normal(planes[i]);
+        // the corners furthest along and against the normal
+        glm::vec3 positive(normal.x >= 0.0f ? max.x : min.x, normal.y >= 0.0f ? max.y : min.y, normal.z >= 0.0f ? max.z : min.z);
+        glm::vec3 negative(normal.x >= 0.0f ? min.x : max.x, normal.y >= 0.0f ? min.y : max.y, normal.z >= 0.0f ? min.z : max.z);
+        if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+            return FRUSTUM_OUTSIDE;
+        if (glm::dot(normal, negative) + planes[i].w < 0.0f)
+            result = FRUSTUM_INTERSECTS;
+    }
+    return result;
+}
+
+void Frustum::testSpheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible) const {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i), cy = _mm_loadu_ps(y + i), cz = _mm_loadu_ps(z + i);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p].x)), _mm_set1_ps(planes[p].w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cy, _mm_set1_ps(planes[p].y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(cz, _mm_set1_ps(planes[p].z)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t cx = vld1q_f32(x + i), cy = vld1q_f32(y + i), cz = vld1q_f32(z + i);
+        float32x4_t negativeRadius = vnegq_f32(vld1q_f32(radius + i));
+        uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+        for (int p = 0; p < 6; p++) {
+            float32x4_t distance = vaddq_f32(vmulq_n_f32(cx, planes[p].x), vdupq_n_f32(planes[p].w));
+            distance = vaddq_f32(distance, vmulq_n_f32(cy, planes[p].y));
+            distance = vaddq_f32(distance, vmulq_n_f32(cz, planes[p].z));
+            inside = vandq_u32(inside, vcgeq_f32(distance, negativeRadius));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = lanes[lane] ? 1 : 0;
+    }
+#endif
+    for (; i < count; i++)
+        visible[i] = intersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include <GeometryArena.h>
+#include <RenderObject.h>
+#include <iostream>
+
+GeometryArena::GeometryArena() : VAO(0), VBO(0), EBO(0), depthVAO(0), positionVBO(0), format(VERTEX_FLOAT), indexType(GL_UNSIGNED_SHORT) {}
+
+GeometryArena::~GeometryArena() {
+    if (VAO) {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &positionVBO);
+    }
+}
+
+bool GeometryArena::build(const std::vector<RenderObject*> &objects) {
+    // distinct meshes, several objects may share one
+    std::vector<std::shared_ptr<MeshAsset> > distinct;
+    for (size_t i = 0; i < objects.size(); i++) {
+        std::shared_ptr<MeshAsset> mesh = objects[i]->mesh();
+        if (!mesh || !mesh->ready())
+            continue;
+        bool seen = false;
+        for (size_t j = 0; j < distinct.size() && !seen; j++)
+            seen = distinct[j] == mesh;
+        if (seen)
+            continue;
+        if (!distinct.empty() && mesh->format != distinct[0]->format) {
+            std::cout << "WARN: arena needs a single vertex format, " << mesh->path << " differs" << std::endl;
+            return false;
+        }
+        distinct.push_back(mesh);
+    }
+    if (distinct.empty())
+        return false;
+
+    format = distinct[0]->format;
+    indexType = GL_UNSIGNED_SHORT;
+    size_t vertexBytes = 0, positionBytes = 0, indexCount = 0;
+    for (size_t i = 0; i < distinct.size(); i++) {
+        if (distinct[i]->indexType == GL_UNSIGNED_INT)
+            indexType = GL_UNSIGNED_INT;
+        vertexBytes += distinct[i]->vertexBytes;
+        positionBytes += distinct[i]->positionBytes;
+        indexCount += distinct[i]->indexBytes / distinct[i]->indexSize();
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(), NULL, GL_STATIC_DRAW);
+    setupVertexAttributes(format);
+
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+    glBindVertexArray(depthVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positionBytes, NULL, GL_STATIC_DRAW);
+    setupPositionAttribute(format);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    unsigned int stride = vertexStride(format);
+    size_t vertexOffset = 0, positionOffset = 0, indexOffset = 0;
+    std::vector<unsigned short> narrow;
+    std::vector<unsigned int> wide;
+    for (size_t i = 0; i < distinct.size(); i++) {
+        MeshAsset &mesh = *distinct[i];
+        size_t meshIndices = mesh.indexBytes / mesh.indexSize();
+
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, vertexOffset, mesh.vertexBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.positionVBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, positionVBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, positionOffset, mesh.positionBytes);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.EBO);
+        if (mesh.indexType == indexType) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, indexOffset * indexSize(), mesh.indexBytes);
+        } else {
+            // the only mismatch is a 16-bit mesh in a 32-bit arena, widened through the CPU
+            narrow.resize(meshIndices);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mesh.indexBytes, narrow.data());
+            wide.assign(narrow.begin(), narrow.end());
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset * indexSize(), meshIndices * sizeof(unsigned int), wide.data());
+        }
+
+        ArenaRange range = {static_cast<GLint>(vertexOffset / stride), static_cast<GLuint>(indexOffset)};
+        ranges[&mesh] = range;
+        vertexOffset += mesh.vertexBytes;
+        positionOffset += mesh.positionBytes;
+        indexOffset += meshIndices;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindVertexArray(0);
+
+    meshes = distinct;
+    std::cout << "ARENA: " << distinct.size() << " meshes, " << vertexBytes / 1024 << " KB vertices, "
+              << indexCount * indexSize() / 1024 << " KB indices (" << (indexType == GL_UNSIGNED_INT ? 32 : 16) << "-bit)" << std::endl;
+    return true;
+}
@@ -0,0 +1,431 @@
+#include <GpuCuller.h>
+#include <RenderObject.h>
+#include <InstanceBuffer.h>
+#include <SceneCuller.h>
+#include <Frustum.h>
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// GL 4.3, not part of the 3.3 glad header
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+namespace {
+
+const unsigned int CULL_GROUP_SIZE = 64;
+const unsigned int REDUCE_GROUP_SIZE = 8;
+
+// one invocation per instance: frustum test of the sphere, occlusion test of the box against
+// the previous frame's depth, then an append to the command's range of the visible buffer
+const char *CULL_SHADER = "#version 430 core\n"
+    "layout (local_size_x = 64) in;\n"
+    "struct Instance {\n"
+    "   mat4 model;\n"
+    "   vec4 normal[3];\n"
+    "   ivec4 draw;\n"
+    "};\n"
+    "struct Bounds {\n"
+    "   vec4 sphere;\n"
+    "   vec4 minimum;\n"
+    "   vec4 maximum;\n"
+    "};\n"
+    "struct Command {\n"
+    "   uint count;\n"
+    "   uint instanceCount;\n"
+    "   uint firstIndex;\n"
+    "   int baseVertex;\n"
+    "   uint baseInstance;\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };\n"
+    "layout (std430, binding = 1) readonly buffer InstanceBounds { Bounds bounds[]; };\n"
+    "layout (std430, binding = 2) buffer Commands { Command commands[]; };\n"
+    "layout (std430, binding = 3) writeonly buffer Visible { Instance visible[]; };\n"
+    "uniform int instanceCount;\n"
+    "uniform vec4 planes[6];\n"
+    "uniform bool occlusion;\n"
+    "uniform mat4 pyramidViewProjection;\n"
+    "uniform vec2 pyramidSize;\n"
+    "uniform int pyramidLevels;\n"
+    "uniform sampler2D pyramid;\n"
+
+    "bool occluded(Bounds b)\n"
+    "{\n"
+    // screen rectangle and nearest depth of the box as the pyramid's camera saw it
+    "   vec3 lo = vec3(1.0);\n"
+    "   vec3 hi = vec3(0.0);\n"
+    "   for (int corner = 0; corner < 8; corner++) {\n"
+    "      vec3 p = mix(b.minimum.xyz, b.maximum.xyz, vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));\n"
+    "      vec4 clip = pyramidViewProjection * vec4(p, 1.0);\n"
+    "      if (clip.w < 1e-5 || clip.z < -clip.w)\n"
+    "         return false;\n"
+    "      vec3 window = clip.xyz / clip.w * 0.5 + 0.5;\n"
+    "      lo = min(lo, window);\n"
+    "      hi = max(hi, window);\n"
+    "   }\n"
+    "   lo.xy = clamp(lo.xy, 0.0, 1.0);\n"
+    "   hi.xy = clamp(hi.xy, 0.0, 1.0);\n"
+    // the level whose texels are at least as large as the rectangle, it touches 2x2 at most
+    "   vec2 size = (hi.xy - lo.xy) * pyramidSize;\n"
+    "   float level = clamp(ceil(log2(max(max(size.x, size.y), 1.0))), 0.0, float(pyramidLevels - 1));\n"
+    "   float farthest = max(max(textureLod(pyramid, lo.xy, level).r, textureLod(pyramid, vec2(hi.x, lo.y), level).r),\n"
+    "                        max(textureLod(pyramid, vec2(lo.x, hi.y), level).r, textureLod(pyramid, hi.xy, level).r));\n"
+    "   return lo.z > farthest;\n"
+    "}\n"
+
+    "void main()\n"
+    "{\n"
+    "   uint i = gl_GlobalInvocationID.x;\n"
+    "   if (i >= uint(instanceCount))\n"
+    "      return;\n"
+    "   Bounds b = bounds[i];\n"
+    "   for (int p = 0; p < 6; p++) {\n"
+    "      if (dot(planes[p].xyz, b.sphere.xyz) + planes[p].w < -b.sphere.w)\n"
+    "         return;\n"
+    "   }\n"
+    "   if (occlusion && occluded(b))\n"
+    "      return;\n"
+    "   int draw = instances[i].draw.x;\n"
+    "   uint slot = atomicAdd(commands[draw].instanceCount, 1u);\n"
+    "   visible[commands[draw].baseInstance + slot] = instances[i];\n"
+    "}\0";
+
+// one pyramid level from the next finer one (or the depth buffer): each texel keeps the
+// farthest of its 2x2 source texels, the last row and column also take an odd source's edge
+const char *REDUCE_SHADER = "#version 430 core\n"
+    "layout (local_size_x = 8, local_size_y = 8) in;\n"
+    "layout (r32f, binding = 0) writeonly uniform image2D target;\n"
+    "uniform sampler2D source;\n"
+    "void main()\n"
+    "{\n"
+    "   ivec2 size = imageSize(target);\n"
+    "   ivec2 texel = ivec2(gl_GlobalInvocationID.xy);\n"
+    "   if (any(greaterThanEqual(texel, size)))\n"
+    "      return;\n"
+    "   ivec2 sourceSize = textureSize(source, 0);\n"
+    "   ivec2 last = min(texel * 2 + 1 + ivec2(equal(texel, size - 1)) * (sourceSize - size * 2), sourceSize - 1);\n"
+    "   float farthest = 0.0;\n"
+    "   for (int y = texel.y * 2; y <= last.y; y++) {\n"
+    "      for (int x = texel.x * 2; x <= last.x; x++)\n"
+    "         farthest = max(farthest, texelFetch(source, ivec2(x, y), 0).r);\n"
+    "   }\n"
+    "   imageStore(target, texel, vec4(farthest));\n"
+    "}\0";
+
+}
+
+GpuCuller::GpuCuller(GeometryArena &arena)
+    : arena(arena), dispatchCompute(NULL), memoryBarrier(NULL), bindImageTexture(NULL), multiDrawElementsIndirect(NULL),
+      instanceCount(0), drawCount(0), instanceBuffer(0), boundsBuffer(0), visibleBuffer(0), commandTemplate(0),
+      commandBuffer(0), drawBuffer(0), depthTexture(0), pyramidTexture(0), depthWidth(0), depthHeight(0),
+      pyramidWidth(0), pyramidHeight(0), pyramidLevels(0), pyramidValid(false), frames(0) {}
+
+GpuCuller::~GpuCuller() {
+    unsigned int buffers[] = {instanceBuffer, boundsBuffer, visibleBuffer, commandTemplate, commandBuffer, drawBuffer};
+    for (size_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); i++) {
+        if (buffers[i])
+            glDeleteBuffers(1, &buffers[i]);
+    }
+    if (depthTexture)
+        glDeleteTextures(1, &depthTexture);
+    if (pyramidTexture)
+        glDeleteTextures(1, &pyramidTexture);
+    if (cullShader)
+        glDeleteProgram(cullShader->ID);
+    if (reduceShader)
+        glDeleteProgram(reduceShader->ID);
+}
+
+bool GpuCuller::init(GLADloadproc load) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major < 4 || (major == 4 && minor < 3)) {
+        std::cout << "GPU CULL: needs GL 4.3, context is " << major << "." << minor << std::endl;
+        return false;
+    }
+
+    dispatchCompute = (DispatchComputeProc)load("glDispatchCompute");
+    memoryBarrier = (MemoryBarrierProc)load("glMemoryBarrier");
+    bindImageTexture = (BindImageTextureProc)load("glBindImageTexture");
+    multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+    if (!dispatchCompute || !memoryBarrier || !bindImageTexture || !multiDrawElementsIndirect)
+        return false;
+
+    cullShader.reset(new Shader(CULL_SHADER));
+    reduceShader.reset(new Shader(REDUCE_SHADER));
+    if (!cullShader->linked() || !reduceShader->linked())
+        return false;
+
+    cullShader->use();
+    cullShader->setInt(UNIFORM("pyramid"), PYRAMID_TEXTURE_UNIT);
+    reduceShader->use();
+    reduceShader->setInt(UNIFORM("source"), PYRAMID_TEXTURE_UNIT);
+    return true;
+}
+
+bool GpuCuller::build(const std::vector<RenderObject*> &objects) {
+    if (!cullShader || objects.empty() || objects.size() > static_cast<size_t>(MAX_INDIRECT_DRAWS))
+        return false;
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawData> draws;
+    std::vector<Instance> instances;
+    std::vector<Bounds> bounds;
+    entityDraws.clear();
+    drawBounds.clear();
+    drawInstances.clear();
+    for (size_t draw = 0; draw < objects.size(); draw++) {
+        const RenderObject &object = *objects[draw];
+        if (!object.ready() || object.materialIndex() < 0 || !arena.contains(*object.mesh()))
+            return false;
+
+        const MeshLod &lod = object.mesh()->lods[0];
+        const ArenaRange &range = arena.range(*object.mesh());
+        DrawElementsIndirectCommand command;
+        command.count = static_cast<GLuint>(lod.indexCount);
+        command.instanceCount = 0;
+        command.firstIndex = range.firstIndex + static_cast<GLuint>(lod.indexOffset);
+        command.baseVertex = range.baseVertex;
+        command.baseInstance = static_cast<GLuint>(instances.size());
+        commands.push_back(command);
+        draws.push_back(makeDrawData(object.world(), object.index()));
+        drawBounds.push_back(object.mesh()->bounds);
+        drawInstances.push_back(command.baseInstance);
+        if (!object.instances()) {
+            if (entityDraws.size() <= object.index())
+                entityDraws.resize(object.index() + 1, -1);
+            entityDraws[object.index()] = static_cast<int32_t>(draw);
+        }
+
+        for (size_t i = 0; i < object.instanceCount(); i++) {
+            InstanceTransform transform = object.instances() ? InstanceTransform(object.instances()->get(i))
+                                                             : InstanceTransform(object.transform(), object.normalMatrix());
+            Instance instance = {transform, {static_cast<int32_t>(draw), 0, 0, 0}};
+            instances.push_back(instance);
+            WorldBounds world = transformBounds(object.mesh()->bounds, transform.model);
+            Bounds box = {glm::vec4(world.center, world.radius), glm::vec4(world.min, 1.0f), glm::vec4(world.max, 1.0f)};
+            bounds.push_back(box);
+        }
+    }
+    if (instances.empty())
+        return false;
+
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &boundsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(Bounds), bounds.data(), GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &visibleBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(Instance), NULL, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &commandTemplate);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandTemplate);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glGenBuffers(1, &drawBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, drawBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_INDIRECT_DRAWS * sizeof(DrawData), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, draws.size() * sizeof(DrawData), draws.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    instanceCount = static_cast<unsigned int>(instances.size());
+    drawCount = static_cast<unsigned int>(commands.size());
+    std::cout << "GPU CULL: " << instanceCount << " instances in " << drawCount << " draws culled by compute" << std::endl;
+    return true;
+}
+
+void GpuCuller::refit(const std::vector<uint32_t> &indices, const std::vector<InstanceTransform> &transforms) {
+    if (!ready())
+        return;
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] >= entityDraws.size() || entityDraws[indices[i]] < 0)
+            continue;
+        int32_t draw = entityDraws[indices[i]];
+        GLintptr instance = drawInstances[draw];
+
+        Instance moved = {transforms[i], {draw, 0, 0, 0}};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, instance * sizeof(Instance), sizeof(Instance), &moved);
+
+        WorldBounds world = transformBounds(drawBounds[draw], transforms[i].model);
+        Bounds box = {glm::vec4(world.center, world.radius), glm::vec4(world.min, 1.0f), glm::vec4(world.max, 1.0f)};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, instance * sizeof(Bounds), sizeof(Bounds), &box);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::cull(const RenderView &view) {
+    if (!ready())
+        return;
+
+    // commands start every frame with no instances
+    glBindBuffer(GL_COPY_READ_BUFFER, commandTemplate);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, drawCount * sizeof(DrawElementsIndirectCommand));
+
+    frameViewProjection = view.projection * view.view;
+    Frustum frustum = Frustum::fromMatrix(frameViewProjection);
+
+    cullShader->use();
+    cullShader->setInt(UNIFORM("instanceCount"), static_cast<int>(instanceCount));
+    static const uint32_t planeNames[6] = {
+        UNIFORM("planes[0]"), UNIFORM("planes[1]"), UNIFORM("planes[2]"),
+        UNIFORM("planes[3]"), UNIFORM("planes[4]"), UNIFORM("planes[5]")
+    };
+    for (int i = 0; i < 6; i++)
+        cullShader->setVec4(planeNames[i], frustum.planes[i]);
+    // a previous frame is only tested against once its depth was captured
+    cullShader->setBool(UNIFORM("occlusion"), pyramidValid);
+    if (pyramidValid) {
+        cullShader->setMat4(UNIFORM("pyramidViewProjection"), pyramidViewProjection);
+        cullShader->setVec2(UNIFORM("pyramidSize"), static_cast<float>(pyramidWidth), static_cast<float>(pyramidHeight));
+        cullShader->setInt(UNIFORM("pyramidLevels"), pyramidLevels);
+        glActiveTexture(GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+    dispatchCompute((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    // the draw reads the counts as commands and the survivors as vertex attributes
+    memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    report();
+}
+
+void GpuCuller::drawDepth(Shader &shader) {
+    if (ready())
+        drawCommands(shader, arena.depthVAO);
+}
+
+void GpuCuller::draw(Shader &shader) {
+    if (ready())
+        drawCommands(shader, arena.VAO);
+}
+
+void GpuCuller::drawCommands(Shader &shader, unsigned int vao) {
+    shader.use();
+    glBindBufferBase(GL_UNIFORM_BUFFER, DRAW_BINDING, drawBuffer);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    InstanceBuffer::pointAttributes(sizeof(Instance), offsetof(Instance, transform));
+    glVertexAttribIPointer(DRAW_ATTRIBUTE, 1, GL_INT, sizeof(Instance), (void*)offsetof(Instance, draw));
+    glVertexAttribDivisor(DRAW_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(DRAW_ATTRIBUTE);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    multiDrawElementsIndirect(GL_TRIANGLES, arena.indexType, NULL, static_cast<GLsizei>(drawCount), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void GpuCuller::resizeDepth(int width, int height) {
+    depthWidth = width;
+    depthHeight = height;
+    pyramidWidth = std::max(1, width / 2);
+    pyramidHeight = std::max(1, height / 2);
+    pyramidLevels = 1;
+    while ((pyramidWidth >> pyramidLevels) > 0 || (pyramidHeight >> pyramidLevels) > 0)
+        pyramidLevels++;
+
+    if (!depthTexture) {
+        glGenTextures(1, &depthTexture);
+        glGenTextures(1, &pyramidTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // floor-halved levels keep the chain complete
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    for (int level = 0; level < pyramidLevels; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, pyramidWidth >> level), std::max(1, pyramidHeight >> level), 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramidLevels - 1);
+    pyramidValid = false;
+}
+
+void GpuCuller::captureDepth(int width, int height) {
+    if (!ready() || width <= 0 || height <= 0)
+        return;
+    if (width != depthWidth || height != depthHeight)
+        resizeDepth(width, height);
+
+    glActiveTexture(GL_TEXTURE0 + PYRAMID_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+    reduceShader->use();
+    for (int level = 0; level < pyramidLevels; level++) {
+        // level 0 reads the depth copy, the others the level above them, limited to that one
+        // level so the texture is never read and written at the same level
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        bindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        GLuint groupsX = (std::max(1, pyramidWidth >> level) + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE;
+        GLuint groupsY = (std::max(1, pyramidHeight >> level) + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE;
+        dispatchCompute(groupsX, groupsY, 1);
+        memoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, pyramidLevels - 1);
+
+    pyramidViewProjection = frameViewProjection;
+    pyramidValid = true;
+}
+
+void GpuCuller::report() {
+    if (++frames < GPU_CULL_REPORT_FRAMES)
+        return;
+    frames = 0;
+
+    // waits for this frame's cull, hence only every few seconds
+    std::vector<DrawElementsIndirectCommand> commands(drawCount);
+    memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    unsigned int visible = 0;
+    for (size_t i = 0; i < commands.size(); i++)
+        visible += commands[i].instanceCount;
+    std::cout << "GPU CULL: " << visible << " of " << instanceCount << " instances drawn" << std::endl;
+}
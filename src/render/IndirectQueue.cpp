@@ -0,0 +1,197 @@
+#include <IndirectQueue.h>
+#include <RenderObject.h>
+#include <InstanceBuffer.h>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// GL 4.0, not part of the 3.3 glad header
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+DrawData makeDrawData(const SceneWorld &world, uint32_t index) {
+    const VertexQuantization &quantization = world.meshes[index]->quantization;
+    DrawData data = {
+        {quantization.offset.x, quantization.offset.y, quantization.offset.z, 0.0f},
+        {quantization.scale.x, quantization.scale.y, quantization.scale.z, 0.0f},
+        {world.materials[index].batchIndex, 0, 0, 0}
+    };
+    return data;
+}
+
+std::string IndirectQueue::shaderDefines() {
+    std::ostringstream defines;
+    defines << "#define INDIRECT_DRAW\n#define MAX_INDIRECT_DRAWS " << MAX_INDIRECT_DRAWS << "\n";
+    return defines.str();
+}
+
+IndirectQueue::IndirectQueue(GeometryArena &arena)
+    : arena(arena), commandBuffer(0), drawBuffer(0), instanceBuffer(0), uploaded(false),
+      multiDrawElementsIndirect(NULL) {
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    std::memset(&reportedStats, 0, sizeof(reportedStats));
+}
+
+IndirectQueue::~IndirectQueue() {
+    if (commandBuffer)
+        glDeleteBuffers(1, &commandBuffer);
+    if (drawBuffer)
+        glDeleteBuffers(1, &drawBuffer);
+    if (instanceBuffer)
+        glDeleteBuffers(1, &instanceBuffer);
+}
+
+bool IndirectQueue::loadMultiDraw(GLADloadproc load) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 3))
+        multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)load("glMultiDrawElementsIndirect");
+
+    std::cout << "INDIRECT: GL " << major << "." << minor << ", "
+              << (multiDraw() ? "one glMultiDrawElementsIndirect per frame" : "one base-vertex draw per command") << std::endl;
+    return multiDraw();
+}
+
+void IndirectQueue::begin(const RenderView &renderView) {
+    view = renderView;
+    uploaded = false;
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    commands.clear();
+    draws.clear();
+    instances.clear();
+}
+
+bool IndirectQueue::submit(SceneWorld &world, uint32_t index, const std::vector<uint32_t> *subset) {
+    if (!world.ready(index) || world.materials[index].batchIndex < 0 || !arena.contains(*world.meshes[index]))
+        return false;
+    if (draws.size() >= static_cast<size_t>(MAX_INDIRECT_DRAWS))
+        return false;
+    unsigned int instanceCount = subset ? static_cast<unsigned int>(subset->size()) : world.instanceCount(index);
+    if (instanceCount == 0)
+        return true;
+
+    const MeshAsset &mesh = *world.meshes[index];
+    const MeshLod &lod = mesh.lods[world.selectLod(index, view, subset)];
+    const ArenaRange &range = arena.range(mesh);
+    int32_t draw = static_cast<int32_t>(draws.size());
+
+    DrawElementsIndirectCommand command;
+    command.count = static_cast<GLuint>(lod.indexCount);
+    command.instanceCount = instanceCount;
+    command.firstIndex = range.firstIndex + static_cast<GLuint>(lod.indexOffset);
+    command.baseVertex = range.baseVertex;
+    command.baseInstance = static_cast<GLuint>(instances.size());
+    commands.push_back(command);
+
+    draws.push_back(makeDrawData(world, index));
+
+    const InstanceBuffer *list = world.instances[index].get();
+    if (list) {
+        for (size_t i = 0; i < instanceCount; i++) {
+            Instance instance = {InstanceTransform(list->get(subset ? (*subset)[i] : i)), draw};
+            instances.push_back(instance);
+        }
+    } else {
+        Instance instance = {InstanceTransform(world.transforms[index], world.normalMatrices[index]), draw};
+        instances.push_back(instance);
+    }
+    return true;
+}
+
+bool IndirectQueue::submit(RenderObject &object, const std::vector<uint32_t> *subset) {
+    return submit(object.world(), object.index(), subset);
+}
+
+void IndirectQueue::pointInstances(size_t first) {
+    size_t base = first * sizeof(Instance);
+    InstanceBuffer::pointAttributes(sizeof(Instance), base + offsetof(Instance, transform));
+    glVertexAttribIPointer(DRAW_ATTRIBUTE, 1, GL_INT, sizeof(Instance), (void*)(base + offsetof(Instance, draw)));
+    glVertexAttribDivisor(DRAW_ATTRIBUTE, 1);
+    glEnableVertexAttribArray(DRAW_ATTRIBUTE);
+}
+
+void IndirectQueue::upload() {
+    if (uploaded)
+        return;
+    uploaded = true;
+
+    if (!drawBuffer) {
+        glGenBuffers(1, &drawBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, drawBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, MAX_INDIRECT_DRAWS * sizeof(DrawData), NULL, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &instanceBuffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, drawBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, draws.size() * sizeof(DrawData), draws.data());
+
+    // rewritten every frame, a fresh store lets the driver skip waiting on the last one
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+
+    if (multiDraw()) {
+        if (!commandBuffer)
+            glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
+
+void IndirectQueue::drawCommands(unsigned int vao) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, DRAW_BINDING, drawBuffer);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    if (multiDraw()) {
+        // baseInstance offsets the instance attributes per command
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        pointInstances(0);
+        multiDrawElementsIndirect(GL_TRIANGLES, arena.indexType, NULL, static_cast<GLsizei>(commands.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        frameStats.calls++;
+    } else {
+        // no baseInstance before 4.2, so the attributes move to each command's first instance
+        for (size_t i = 0; i < commands.size(); i++) {
+            const DrawElementsIndirectCommand &command = commands[i];
+            pointInstances(command.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(command.count), arena.indexType,
+                                              (void*)(command.firstIndex * arena.indexSize()),
+                                              static_cast<GLsizei>(command.instanceCount), command.baseVertex);
+        }
+        frameStats.calls += static_cast<unsigned int>(commands.size());
+    }
+
+    glBindVertexArray(0);
+}
+
+void IndirectQueue::flushDepth(Shader &shader) {
+    if (commands.empty())
+        return;
+    upload();
+    shader.use();
+    drawCommands(arena.depthVAO);
+}
+
+void IndirectQueue::flush(Shader &shader) {
+    frameStats.draws = static_cast<unsigned int>(commands.size());
+    frameStats.instances = static_cast<unsigned int>(instances.size());
+    if (!commands.empty()) {
+        upload();
+        shader.use();
+        drawCommands(arena.VAO);
+    }
+    report();
+}
+
+void IndirectQueue::report() {
+    // only when something changed, like RenderQueue
+    if (std::memcmp(&frameStats, &reportedStats, sizeof(frameStats)) == 0)
+        return;
+    reportedStats = frameStats;
+
+    std::cout << "INDIRECT: " << frameStats.draws << " draws (" << frameStats.instances << " instances) in "
+              << frameStats.calls << " calls" << std::endl;
+}
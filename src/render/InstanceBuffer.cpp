@@ -0,0 +1,125 @@
+#include <InstanceBuffer.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+// smallest allocation, so a handful of add() calls does not reallocate every frame
+const size_t MIN_INSTANCE_CAPACITY = 16;
+
+}
+
+glm::mat3 normalMatrix(const glm::mat4 &model) {
+    // the rows of the inverse are the cross products of the other two columns over the
+    // determinant, so its transpose has them as columns
+    glm::vec3 x(model[0]), y(model[1]), z(model[2]);
+    glm::vec3 yz = glm::cross(y, z), zx = glm::cross(z, x), xy = glm::cross(x, y);
+    float determinant = glm::dot(x, yz);
+    // a flattened model has no inverse, the shader normalizes whatever direction is left
+    float scale = determinant != 0.0f ? 1.0f / determinant : 1.0f;
+    return glm::mat3(yz * scale, zx * scale, xy * scale);
+}
+
+InstanceTransform::InstanceTransform(const glm::mat4 &model) : model(model) {
+    glm::mat3 normal = normalMatrix(model);
+    for (int column = 0; column < 3; column++)
+        this->normal[column] = glm::vec4(normal[column], 0.0f);
+}
+
+InstanceTransform::InstanceTransform(const glm::mat4 &model, const glm::mat3 &normal) : model(model) {
+    for (int column = 0; column < 3; column++)
+        this->normal[column] = glm::vec4(normal[column], 0.0f);
+}
+
+InstanceBuffer::InstanceBuffer() : buffer(0), capacity(0), dirtyBegin(0), dirtyEnd(0) {}
+
+InstanceBuffer::~InstanceBuffer() {
+    if (buffer)
+        glDeleteBuffers(1, &buffer);
+}
+
+size_t InstanceBuffer::add(const glm::mat4 &transform) {
+    transforms.push_back(InstanceTransform(transform));
+    markDirty(transforms.size() - 1, transforms.size());
+    return transforms.size() - 1;
+}
+
+void InstanceBuffer::set(size_t index, const glm::mat4 &transform) {
+    transforms[index] = InstanceTransform(transform);
+    markDirty(index, index + 1);
+}
+
+void InstanceBuffer::remove(size_t index) {
+    if (index + 1 < transforms.size()) {
+        transforms[index] = transforms.back();
+        markDirty(index, index + 1);
+    }
+    transforms.pop_back();
+}
+
+void InstanceBuffer::clear() {
+    transforms.clear();
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void InstanceBuffer::markDirty(size_t begin, size_t end) {
+    if (dirtyBegin == dirtyEnd) {
+        dirtyBegin = begin;
+        dirtyEnd = end;
+    } else {
+        dirtyBegin = std::min(dirtyBegin, begin);
+        dirtyEnd = std::max(dirtyEnd, end);
+    }
+}
+
+void InstanceBuffer::upload() {
+    if (!buffer)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    if (transforms.size() > capacity) {
+        // grow geometrically and send everything, the old contents are gone with the old storage
+        capacity = std::max(std::max(transforms.size(), capacity * 2), MIN_INSTANCE_CAPACITY);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceTransform), NULL, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = transforms.size();
+    }
+
+    // removals can leave the range past the end of the list
+    dirtyEnd = std::min(dirtyEnd, transforms.size());
+    if (dirtyBegin < dirtyEnd)
+        glBufferSubData(GL_ARRAY_BUFFER, dirtyBegin * sizeof(InstanceTransform), (dirtyEnd - dirtyBegin) * sizeof(InstanceTransform), &transforms[dirtyBegin]);
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void InstanceBuffer::bind() {
+    upload();
+    pointAttributes(sizeof(InstanceTransform), 0);
+}
+
+void InstanceBuffer::pointAttributes(GLsizei stride, size_t offset) {
+    // a mat4 attribute takes four consecutive vec4 locations, one column each, the mat3 three
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + column, 1);
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + column);
+    }
+    for (GLuint column = 0; column < 3; column++) {
+        glVertexAttribPointer(NORMAL_ATTRIBUTE + column, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceTransform, normal) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(NORMAL_ATTRIBUTE + column, 1);
+        glEnableVertexAttribArray(NORMAL_ATTRIBUTE + column);
+    }
+}
+
+void InstanceBuffer::bindConstant(const glm::mat4 &transform, const glm::mat3 &normal) {
+    // a disabled attribute array reads the current generic value instead
+    for (GLuint column = 0; column < 4; column++) {
+        glDisableVertexAttribArray(INSTANCE_ATTRIBUTE + column);
+        glVertexAttrib4fv(INSTANCE_ATTRIBUTE + column, glm::value_ptr(transform[column]));
+    }
+    for (GLuint column = 0; column < 3; column++) {
+        glDisableVertexAttribArray(NORMAL_ATTRIBUTE + column);
+        glVertexAttrib3fv(NORMAL_ATTRIBUTE + column, glm::value_ptr(normal[column]));
+    }
+}
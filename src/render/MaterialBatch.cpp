@@ -0,0 +1,129 @@
+#include <MaterialBatch.h>
+#include <RenderObject.h>
+#include <texture/Image.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+// std140 layout of one entry of the Materials block
+struct MaterialData {
+    float specular[3];
+    float shininess;
+    int layer;
+    int padding[3];
+};
+
+}
+
+MaterialBatch::MaterialBatch() : textureArray(0), materialBuffer(0), layerSize(0), layerCount(0), materialCount(0) {}
+
+MaterialBatch::~MaterialBatch() {
+    if (textureArray)
+        glDeleteTextures(1, &textureArray);
+    if (materialBuffer)
+        glDeleteBuffers(1, &materialBuffer);
+}
+
+std::string MaterialBatch::shaderDefines() {
+    std::ostringstream defines;
+    defines << "#define MATERIAL_ARRAY\n#define MAX_MATERIALS " << MAX_MATERIALS << "\n";
+    return defines.str();
+}
+
+bool MaterialBatch::build(const std::vector<RenderObject*> &objects) {
+    if (objects.empty() || objects.size() > static_cast<size_t>(MAX_MATERIALS))
+        return false;
+
+    // one layer per distinct texture, the registry already made shared files one asset
+    std::map<TextureAsset*, int> layers;
+    std::vector<std::shared_ptr<LoadedImage> > images;
+    std::vector<int> objectLayers(objects.size());
+    for (size_t i = 0; i < objects.size(); i++) {
+        TextureAsset *texture = objects[i]->texture().get();
+        if (!texture)
+            return false;
+
+        std::map<TextureAsset*, int>::iterator found = layers.find(texture);
+        if (found != layers.end()) {
+            objectLayers[i] = found->second;
+            continue;
+        }
+
+        std::shared_ptr<LoadedImage> image = std::make_shared<LoadedImage>();
+        if (!image->decode(texture->path))
+            return false;
+        objectLayers[i] = layers[texture] = static_cast<int>(images.size());
+        images.push_back(image);
+    }
+
+    // every layer has the same size, the largest source rounded up to a power of two
+    int largest = 0;
+    for (size_t i = 0; i < images.size(); i++)
+        largest = std::max(largest, std::max(images[i]->width, images[i]->height));
+    layerSize = MIN_LAYER_SIZE;
+    while (layerSize < largest && layerSize < MAX_LAYER_SIZE)
+        layerSize *= 2;
+    layerCount = static_cast<int>(images.size());
+
+    for (size_t i = 0; i < images.size(); i++) {
+        images[i]->resample(layerSize, layerSize);
+        images[i]->buildMipChain();
+    }
+
+    int levels = static_cast<int>(images[0]->levelCount());
+    size_t bytes = 0;
+    glGenTextures(1, &textureArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < levels; level++) {
+        ImageLevel size = images[0]->level(level);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size.width, size.height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        for (int layer = 0; layer < layerCount; layer++) {
+            ImageLevel data = images[layer]->level(level);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, data.width, data.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data);
+            bytes += data.bytes;
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // the block is declared with MAX_MATERIALS entries, so the buffer has to cover all of them
+    std::vector<MaterialData> materials(MAX_MATERIALS);
+    materialCount = static_cast<int>(objects.size());
+    for (int i = 0; i < materialCount; i++) {
+        RenderObject &object = *objects[i];
+        MaterialData &material = materials[i];
+        material.specular[0] = object.specular().x;
+        material.specular[1] = object.specular().y;
+        material.specular[2] = object.specular().z;
+        material.shininess = object.shininess();
+        material.layer = objectLayers[i];
+
+        object.materialIndex() = i;
+        // the layer replaces the object's own copy
+        object.texture().reset();
+    }
+
+    glGenBuffers(1, &materialBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, materials.size() * sizeof(MaterialData), materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    std::cout << "MATERIALS: " << materialCount << " materials, " << layerCount << " layers of "
+              << layerSize << "x" << layerSize << " (" << bytes / 1024 << " KB)" << std::endl;
+    return true;
+}
+
+void MaterialBatch::bind(Shader &shader) {
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BINDING, materialBuffer);
+    shader.setInt(UNIFORM("albedoMaps"), MATERIAL_TEXTURE_UNIT);
+}
@@ -0,0 +1,335 @@
+#include <OcclusionCuller.h>
+#include <RenderObject.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// pixel rows rasterized by one job, whole tile rows
+const int BAND_ROWS = OCCLUSION_TILE * 2;
+// clip-space w below which a vertex counts as behind the camera
+const float MIN_CLIP_W = 1e-5f;
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+OcclusionCuller::OcclusionCuller()
+    : depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f),
+      tileDepth((OCCLUSION_WIDTH / OCCLUSION_TILE) * (OCCLUSION_HEIGHT / OCCLUSION_TILE), 1.0f),
+      rasterThreads(0), totalFrames(0) {
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    std::memset(&totalStats, 0, sizeof(totalStats));
+}
+
+bool OcclusionCuller::addOccluder(const RenderObject &object) {
+    if (!object.mesh() || !object.mesh()->ready())
+        return false;
+    const MeshAsset &mesh = *object.mesh();
+
+    // every level's indices follow each other in the buffer
+    size_t indexCount = 0;
+    for (size_t lod = 0; lod < mesh.lods.size(); lod++)
+        indexCount = std::max(indexCount, static_cast<size_t>(mesh.lods[lod].indexOffset) + mesh.lods[lod].indexCount);
+    if (indexCount * mesh.indexSize() > mesh.indexBytes)
+        return false;
+
+    std::vector<unsigned char> vertices(mesh.vertexBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, mesh.VBO);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, mesh.vertexBytes, vertices.data());
+    std::vector<unsigned char> indices(indexCount * mesh.indexSize());
+    glBindBuffer(GL_COPY_READ_BUFFER, mesh.EBO);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indices.size(), indices.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    // keeps only the vertices the levels use, decoded back to object space
+    Occluder occluder;
+    occluder.object = &object;
+    occluder.bounds = mesh.bounds;
+    occluder.indices.resize(mesh.lods.size());
+    std::map<uint32_t, uint32_t> remap;
+    unsigned int stride = vertexStride(mesh.format);
+    for (size_t lod = 0; lod < mesh.lods.size(); lod++) {
+        const MeshLod &level = mesh.lods[lod];
+        occluder.errors.push_back(level.error);
+        for (size_t i = level.indexOffset; i < level.indexOffset + level.indexCount; i++) {
+            uint32_t index;
+            if (mesh.indexType == GL_UNSIGNED_SHORT) {
+                unsigned short narrow;
+                std::memcpy(&narrow, &indices[i * sizeof(narrow)], sizeof(narrow));
+                index = narrow;
+            } else {
+                std::memcpy(&index, &indices[i * sizeof(index)], sizeof(index));
+            }
+
+            // the cache loader checks its indices, this covers every other source
+            if ((static_cast<size_t>(index) + 1) * stride > vertices.size())
+                return false;
+
+            std::map<uint32_t, uint32_t>::iterator found = remap.find(index);
+            if (found == remap.end()) {
+                const unsigned char *vertex = &vertices[static_cast<size_t>(index) * stride];
+                glm::vec3 position;
+                if (mesh.format == VERTEX_PACKED_QUANTIZED) {
+                    uint16_t packed[3];
+                    std::memcpy(packed, vertex, sizeof(packed));
+                    position = mesh.quantization.offset + glm::vec3(packed[0], packed[1], packed[2]) / 65535.0f * mesh.quantization.scale;
+                } else {
+                    std::memcpy(&position[0], vertex, 3 * sizeof(float));
+                }
+                found = remap.insert(std::make_pair(index, static_cast<uint32_t>(occluder.positions.size()))).first;
+                occluder.positions.push_back(position);
+            }
+            occluder.indices[lod].push_back(found->second);
+        }
+    }
+
+    std::cout << "OCCLUSION: " << mesh.path << " occludes with " << mesh.lods.size() << " LODs (" << mesh.lods[0].indexCount / 3
+              << " to " << mesh.lods.back().indexCount / 3 << " triangles)" << std::endl;
+    occluders.push_back(occluder);
+    return true;
+}
+
+void OcclusionCuller::setupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c) {
+    // anything crossing the near plane is left out, fewer occluders only means less culling
+    const glm::vec4 *vertices[3] = {&a, &b, &c};
+    float x[3], y[3], z[3];
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4 &v = *vertices[i];
+        if (v.w < MIN_CLIP_W || v.z < -v.w)
+            return;
+        x[i] = (v.x / v.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        y[i] = (v.y / v.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        z[i] = v.z / v.w * 0.5f + 0.5f;
+    }
+
+    // counter-clockwise front faces have a positive area, like GL_CULL_FACE keeps them
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f))
+        return;
+
+    Triangle triangle;
+    triangle.minX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+    triangle.maxX = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+    triangle.minY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+    triangle.maxY = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        triangle.edgeA[i] = y[i] - y[j];
+        triangle.edgeB[i] = x[j] - x[i];
+        triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+    }
+    triangle.dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.z0 = z[0] - triangle.dzdx * x[0] - triangle.dzdy * y[0];
+    triangles.push_back(triangle);
+}
+
+JobId OcclusionCuller::render(JobSystem &jobs, const RenderView &view, std::initializer_list<JobId> after) {
+    rasterThreads = jobs.size();
+    JobId triangulated = jobs.add([this, view]() { setup(view); }, after);
+    // bands of whole tile rows never share a pixel or a tile
+    JobId rasterized = jobs.parallelFor((OCCLUSION_HEIGHT + BAND_ROWS - 1) / BAND_ROWS, 1, [this](size_t first, size_t last) {
+        rasterizeBand(static_cast<int>(first) * BAND_ROWS, std::min(OCCLUSION_HEIGHT, static_cast<int>(last) * BAND_ROWS));
+    }, {triangulated});
+    return jobs.add([this]() { frameStats.rasterMs = elapsedMs(rasterStart); }, {rasterized});
+}
+
+void OcclusionCuller::setup(const RenderView &view) {
+    rasterStart = std::chrono::steady_clock::now();
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    viewProjection = view.projection * view.view;
+
+    triangles.clear();
+    for (size_t i = 0; i < occluders.size(); i++) {
+        const Occluder &occluder = occluders[i];
+        const RenderObject &object = *occluder.object;
+        size_t instanceCount = object.instanceCount();
+        for (size_t instance = 0; instance < instanceCount; instance++) {
+            const glm::mat4 &model = object.instances() ? object.instances()->get(instance) : object.transform();
+            const std::vector<uint32_t> &indices = occluder.indices[selectLod(occluder, model, view)];
+            glm::mat4 mvp = viewProjection * model;
+            // vertices the level leaves out are transformed anyway, they are few
+            clip.resize(occluder.positions.size());
+            for (size_t v = 0; v < clip.size(); v++)
+                clip[v] = mvp * glm::vec4(occluder.positions[v], 1.0f);
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+                setupTriangle(clip[indices[t]], clip[indices[t + 1]], clip[indices[t + 2]]);
+            frameStats.occluderTriangles += static_cast<unsigned int>(indices.size() / 3);
+        }
+    }
+    frameStats.rasterizedTriangles = static_cast<unsigned int>(triangles.size());
+}
+
+size_t OcclusionCuller::selectLod(const Occluder &occluder, const glm::mat4 &model, const RenderView &view) const {
+    // errors are object-space distances, measured from the nearest point of the instance
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(model * glm::vec4(occluder.bounds.center, 1.0f));
+    float distance = glm::length(center - view.position) - occluder.bounds.radius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    float pixelsPerUnit = scale * view.projection[1][1] * OCCLUSION_HEIGHT * 0.5f / distance;
+    size_t lod = 0;
+    while (lod + 1 < occluder.errors.size() && occluder.errors[lod + 1] * pixelsPerUnit <= OCCLUDER_PIXEL_ERROR)
+        lod++;
+    return lod;
+}
+
+void OcclusionCuller::rasterizeBand(int firstRow, int lastRow) {
+    std::fill(depth.begin() + firstRow * OCCLUSION_WIDTH, depth.begin() + lastRow * OCCLUSION_WIDTH, 1.0f);
+
+    for (size_t t = 0; t < triangles.size(); t++) {
+        const Triangle &triangle = triangles[t];
+        int top = std::max(triangle.minY, firstRow);
+        int bottom = std::min(triangle.maxY, lastRow - 1);
+        // rows start on a multiple of 4 so every group of pixels stays inside the row
+        int left = triangle.minX & ~3;
+
+        for (int y = top; y <= bottom; y++) {
+            float py = y + 0.5f;
+            float *row = &depth[y * OCCLUSION_WIDTH];
+            float rowEdge[3];
+            for (int i = 0; i < 3; i++)
+                rowEdge[i] = triangle.edgeB[i] * py + triangle.edgeC[i];
+            float rowDepth = triangle.z0 + triangle.dzdy * py;
+
+#if defined(__SSE2__)
+            const __m128 laneX = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (int x = left; x <= triangle.maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneX);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(triangle.edgeA[0])), _mm_set1_ps(rowEdge[0])), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(triangle.edgeA[1])), _mm_set1_ps(rowEdge[1])), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(triangle.edgeA[2])), _mm_set1_ps(rowEdge[2])), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(triangle.dzdx)), _mm_set1_ps(rowDepth));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+#elif defined(__ARM_NEON)
+            const float laneOffsets[4] = {0.5f, 1.5f, 2.5f, 3.5f};
+            const float32x4_t laneX = vld1q_f32(laneOffsets);
+            const float32x4_t zero = vdupq_n_f32(0.0f);
+            for (int x = left; x <= triangle.maxX; x += 4) {
+                float32x4_t px = vaddq_f32(vdupq_n_f32(static_cast<float>(x)), laneX);
+                uint32x4_t inside = vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(rowEdge[0]), px, triangle.edgeA[0]), zero);
+                inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(rowEdge[1]), px, triangle.edgeA[1]), zero));
+                inside = vandq_u32(inside, vcgeq_f32(vmlaq_n_f32(vdupq_n_f32(rowEdge[2]), px, triangle.edgeA[2]), zero));
+                float32x4_t z = vmlaq_n_f32(vdupq_n_f32(rowDepth), px, triangle.dzdx);
+                float32x4_t old = vld1q_f32(row + x);
+                vst1q_f32(row + x, vbslq_f32(inside, vminq_f32(old, z), old));
+            }
+#else
+            for (int x = triangle.minX; x <= triangle.maxX; x++) {
+                float px = x + 0.5f;
+                if (triangle.edgeA[0] * px + rowEdge[0] < 0.0f || triangle.edgeA[1] * px + rowEdge[1] < 0.0f || triangle.edgeA[2] * px + rowEdge[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], rowDepth + triangle.dzdx * px);
+            }
+#endif
+        }
+    }
+
+    // farthest depth of each tile in the band
+    int tilesWide = OCCLUSION_WIDTH / OCCLUSION_TILE;
+    for (int tileY = firstRow / OCCLUSION_TILE; tileY < lastRow / OCCLUSION_TILE; tileY++) {
+        for (int tileX = 0; tileX < tilesWide; tileX++) {
+            float farthest = 0.0f;
+            for (int y = tileY * OCCLUSION_TILE; y < (tileY + 1) * OCCLUSION_TILE; y++) {
+                const float *row = &depth[y * OCCLUSION_WIDTH + tileX * OCCLUSION_TILE];
+                for (int x = 0; x < OCCLUSION_TILE; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            tileDepth[tileY * tilesWide + tileX] = farthest;
+        }
+    }
+}
+
+bool OcclusionCuller::testBox(const glm::vec3 &min, const glm::vec3 &max) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    frameStats.tested++;
+
+    // screen rectangle and nearest depth of the box's corners
+    float minX = OCCLUSION_WIDTH, maxX = 0.0f, minY = OCCLUSION_HEIGHT, maxY = 0.0f, nearest = 1.0f;
+    bool visible = false;
+    for (int corner = 0; corner < 8 && !visible; corner++) {
+        glm::vec4 p = viewProjection * glm::vec4(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z, 1.0f);
+        // a box reaching behind the near plane covers the camera, keep it
+        if (p.w < MIN_CLIP_W || p.z < -p.w) {
+            visible = true;
+            break;
+        }
+        float x = (p.x / p.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (p.y / p.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, p.z / p.w * 0.5f + 0.5f);
+    }
+
+    if (!visible) {
+        int left = std::max(0, static_cast<int>(std::floor(minX)));
+        int right = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::floor(maxX)));
+        int top = std::max(0, static_cast<int>(std::floor(minY)));
+        int bottom = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor(maxY)));
+
+        // tiles whose farthest depth is nearer than the box hide it outright, the others
+        // are checked pixel by pixel
+        int tilesWide = OCCLUSION_WIDTH / OCCLUSION_TILE;
+        for (int tileY = top / OCCLUSION_TILE; tileY <= bottom / OCCLUSION_TILE && !visible && left <= right; tileY++) {
+            for (int tileX = left / OCCLUSION_TILE; tileX <= right / OCCLUSION_TILE && !visible; tileX++) {
+                if (tileDepth[tileY * tilesWide + tileX] < nearest)
+                    continue;
+                int y0 = std::max(top, tileY * OCCLUSION_TILE), y1 = std::min(bottom, (tileY + 1) * OCCLUSION_TILE - 1);
+                int x0 = std::max(left, tileX * OCCLUSION_TILE), x1 = std::min(right, (tileX + 1) * OCCLUSION_TILE - 1);
+                for (int y = y0; y <= y1 && !visible; y++) {
+                    for (int x = x0; x <= x1 && !visible; x++)
+                        visible = depth[y * OCCLUSION_WIDTH + x] >= nearest;
+                }
+            }
+        }
+    }
+
+    if (!visible)
+        frameStats.occluded++;
+    frameStats.testMs += elapsedMs(start);
+    return visible;
+}
+
+void OcclusionCuller::report() {
+    totalStats.occluderTriangles += frameStats.occluderTriangles;
+    totalStats.rasterizedTriangles += frameStats.rasterizedTriangles;
+    totalStats.tested += frameStats.tested;
+    totalStats.occluded += frameStats.occluded;
+    totalStats.rasterMs += frameStats.rasterMs;
+    totalStats.testMs += frameStats.testMs;
+    if (++totalFrames < OCCLUSION_REPORT_FRAMES)
+        return;
+
+    std::cout << "OCCLUSION: " << totalStats.rasterizedTriangles / totalFrames << " of " << totalStats.occluderTriangles / totalFrames
+              << " occluder triangles rasterized in " << totalStats.rasterMs / totalFrames << " ms on " << rasterThreads << " threads, "
+              << totalStats.occluded / totalFrames << " of " << totalStats.tested / totalFrames << " boxes occluded ("
+              << (totalStats.tested ? 100 * totalStats.occluded / totalStats.tested : 0) << "%) in " << totalStats.testMs / totalFrames
+              << " ms per frame" << std::endl;
+    std::memset(&totalStats, 0, sizeof(totalStats));
+    totalFrames = 0;
+}
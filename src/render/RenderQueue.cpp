@@ -0,0 +1,204 @@
+#include <RenderQueue.h>
+#include <RenderObject.h>
+#include <SceneWorld.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+const int RADIX_BITS = 8;
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+// IEEE bits of a non-negative float increase with its value
+uint32_t depthBits(float depth) {
+    if (!(depth > 0.0f))
+        return 0;
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+}
+
+uint64_t makeSortKey(RenderPass pass, unsigned int shader, unsigned int material, float depth) {
+    uint32_t depthKey = depthBits(depth);
+    if (pass == PASS_TRANSPARENT)
+        depthKey = ~depthKey;
+    return (static_cast<uint64_t>(pass & 0xf) << 60)
+        | (static_cast<uint64_t>(shader & 0xff) << 52)
+        | (static_cast<uint64_t>(material & 0xfffff) << 32)
+        | depthKey;
+}
+
+void radixSort(const std::vector<uint64_t> &keys, std::vector<uint32_t> &order) {
+    size_t count = keys.size();
+    order.resize(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = static_cast<uint32_t>(i);
+
+    std::vector<uint32_t> scratch(count);
+    size_t histogram[RADIX_BUCKETS];
+    for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+        std::memset(histogram, 0, sizeof(histogram));
+        for (size_t i = 0; i < count; i++)
+            histogram[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+
+        // a digit shared by every key leaves the order as it is
+        if (count == 0 || histogram[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+            continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+            size_t size = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t index = order[i];
+            scratch[histogram[(keys[index] >> shift) & (RADIX_BUCKETS - 1)]++] = index;
+        }
+        order.swap(scratch);
+    }
+}
+
+RenderQueue::RenderQueue() : sorted(false) {
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    std::memset(&reportedStats, 0, sizeof(reportedStats));
+}
+
+void RenderQueue::begin(const RenderView &renderView) {
+    view = renderView;
+    items.clear();
+    keys.clear();
+    sorted = false;
+    std::memset(&frameStats, 0, sizeof(frameStats));
+}
+
+void RenderQueue::submit(SceneWorld &world, uint32_t index, Shader &shader, RenderPass pass) {
+    if (!world.ready(index) || world.instanceCount(index) == 0)
+        return;
+
+    // view-space distance to the nearest point of the nearest copy's bounding sphere
+    float depth = std::numeric_limits<float>::infinity();
+    for (size_t instance = 0; instance < world.instanceCount(index); instance++) {
+        glm::vec3 center;
+        float radius;
+        world.instanceSphere(index, instance, center, radius);
+        depth = std::min(depth, -(view.view * glm::vec4(center, 1.0f)).z - radius);
+    }
+
+    // batched materials only differ by an index, so let depth decide their order
+    const MaterialRef &material = world.materials[index];
+    unsigned int materialKey = material.batchIndex >= 0 ? 0 : material.texture->ID;
+
+    Item item = {&world, index, &shader, pass, world.selectLod(index, view), world.transforms[index], world.normalMatrices[index]};
+    items.push_back(item);
+    keys.push_back(makeSortKey(pass, shader.ID, materialKey, depth));
+}
+
+void RenderQueue::submit(RenderObject &object, Shader &shader, RenderPass pass) {
+    submit(object.world(), object.index(), shader, pass);
+}
+
+bool RenderQueue::sameMaterial(const Item &a, const Item &b) {
+    const MaterialRef &first = a.world->materials[a.index];
+    const MaterialRef &second = b.world->materials[b.index];
+    if (first.batchIndex >= 0 || second.batchIndex >= 0)
+        return first.batchIndex == second.batchIndex;
+    return first.texture == second.texture && first.specular == second.specular && first.shininess == second.shininess;
+}
+
+bool RenderQueue::sameMesh(const Item &a, const Item &b) {
+    // the instance attributes are part of the mesh binding
+    const std::shared_ptr<InstanceBuffer> &instances = a.world->instances[a.index];
+    return a.world->meshes[a.index] == b.world->meshes[b.index] && instances == b.world->instances[b.index]
+        && (instances || a.transform == b.transform);
+}
+
+void RenderQueue::draw(const Item &item) {
+    item.world->drawLod(item.index, item.world->meshes[item.index]->lods[item.lod]);
+}
+
+void RenderQueue::sort() {
+    if (sorted)
+        return;
+    radixSort(keys, order);
+    sorted = true;
+}
+
+void RenderQueue::flushDepth(Shader &shader) {
+    sort();
+    shader.use();
+
+    // no material state, the mesh binding only changes with the mesh or its instances
+    const Item *previous = NULL;
+    for (size_t i = 0; i < order.size(); i++) {
+        Item &item = items[order[i]];
+        if (item.pass != PASS_OPAQUE)
+            continue;
+        if (!previous || !sameMesh(*previous, item))
+            item.world->bindMesh(item.index, shader, item.transform, item.normalMatrix, true);
+        draw(item);
+        frameStats.depthDraws++;
+        previous = &item;
+    }
+}
+
+void RenderQueue::flush() {
+    frameStats.draws = static_cast<unsigned int>(items.size());
+
+    // what drawing in submission order would have cost
+    for (size_t i = 0; i < items.size(); i++) {
+        const Item *previous = i > 0 ? &items[i - 1] : NULL;
+        if (!previous || previous->shader != items[i].shader)
+            frameStats.unsortedShaderChanges++;
+        if (!previous || previous->shader != items[i].shader || !sameMaterial(*previous, items[i]))
+            frameStats.unsortedMaterialChanges++;
+        if (!previous || previous->shader != items[i].shader || !sameMesh(*previous, items[i]))
+            frameStats.unsortedMeshChanges++;
+    }
+
+    sort();
+
+    // uniforms belong to the program, so a shader change rebinds material and mesh as well
+    const Item *previous = NULL;
+    for (size_t i = 0; i < order.size(); i++) {
+        Item &item = items[order[i]];
+        bool shaderChanged = !previous || previous->shader != item.shader;
+        if (shaderChanged) {
+            item.shader->use();
+            frameStats.shaderChanges++;
+        }
+        if (shaderChanged || !sameMaterial(*previous, item)) {
+            item.world->bindMaterial(item.index, *item.shader);
+            frameStats.materialChanges++;
+        }
+        if (shaderChanged || !sameMesh(*previous, item)) {
+            item.world->bindMesh(item.index, *item.shader, item.transform, item.normalMatrix);
+            frameStats.meshChanges++;
+        }
+        draw(item);
+        frameStats.instances += item.world->instanceCount(item.index);
+        previous = &item;
+    }
+
+    report();
+}
+
+void RenderQueue::report() {
+    // only when something changed, a still camera would otherwise print every frame
+    if (std::memcmp(&frameStats, &reportedStats, sizeof(frameStats)) == 0)
+        return;
+    reportedStats = frameStats;
+
+    std::cout << "QUEUE: " << frameStats.draws << " draws (" << frameStats.instances << " instances), state changes (saved by sorting): shader "
+              << frameStats.shaderChanges << " (" << static_cast<int>(frameStats.unsortedShaderChanges - frameStats.shaderChanges)
+              << "), material " << frameStats.materialChanges << " (" << static_cast<int>(frameStats.unsortedMaterialChanges - frameStats.materialChanges)
+              << "), mesh " << frameStats.meshChanges << " (" << static_cast<int>(frameStats.unsortedMeshChanges - frameStats.meshChanges)
+              << ")";
+    if (frameStats.depthDraws)
+        std::cout << ", " << frameStats.depthDraws << " depth pre-pass draws";
+    std::cout << std::endl;
+}
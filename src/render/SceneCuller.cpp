@@ -0,0 +1,272 @@
+#include <SceneCuller.h>
+#include <SceneWorld.h>
+#include <OcclusionCuller.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// orders items by the center of their box along one axis
+struct CenterLess {
+    const std::vector<glm::vec3> *boxMin, *boxMax;
+    int axis;
+
+    bool operator()(uint32_t a, uint32_t b) const {
+        return (*boxMin)[a][axis] + (*boxMax)[a][axis] < (*boxMin)[b][axis] + (*boxMax)[b][axis];
+    }
+};
+
+template <typename T>
+void permute(std::vector<T> &values, const std::vector<uint32_t> &order) {
+    std::vector<T> sorted(values.size());
+    for (size_t i = 0; i < order.size(); i++)
+        sorted[i] = values[order[i]];
+    values.swap(sorted);
+}
+
+}
+
+WorldBounds transformBounds(const MeshBounds &bounds, const glm::mat4 &model) {
+    WorldBounds world;
+
+    // sphere: moved center, radius grown by the largest axis scale
+    world.center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    world.radius = bounds.radius * scale;
+
+    // box: the transformed box's extent along each world axis (Arvo)
+    glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+    glm::vec3 center = glm::vec3(model * glm::vec4((bounds.max + bounds.min) * 0.5f, 1.0f));
+    glm::mat3 absolute(model);
+    for (int column = 0; column < 3; column++)
+        absolute[column] = glm::abs(absolute[column]);
+    glm::vec3 worldExtent = absolute * extent;
+    world.min = center - worldExtent;
+    world.max = center + worldExtent;
+    return world;
+}
+
+SceneCuller::SceneCuller(const char *label) : occlusion(NULL), label(label) {
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    std::memset(&reportedStats, 0, sizeof(reportedStats));
+}
+
+void SceneCuller::build(const SceneWorld &world) {
+    x.clear(); y.clear(); z.clear(); radius.clear();
+    boxMin.clear(); boxMax.clear();
+    itemEntity.clear(); itemInstance.clear();
+    culled.assign(world.size(), false);
+    instances.assign(world.size(), std::vector<uint32_t>());
+
+    for (uint32_t index = 0; index < world.size(); index++) {
+        const MeshAsset *mesh = world.meshes[index].get();
+        if (!mesh || !mesh->ready())
+            continue;
+        culled[index] = true;
+
+        const InstanceBuffer *list = world.instances[index].get();
+        size_t count = world.instanceCount(index);
+        for (size_t instance = 0; instance < count; instance++) {
+            const glm::mat4 &model = list ? list->get(instance) : world.transforms[index];
+            WorldBounds bounds = transformBounds(mesh->bounds, model);
+            x.push_back(bounds.center.x);
+            y.push_back(bounds.center.y);
+            z.push_back(bounds.center.z);
+            radius.push_back(bounds.radius);
+            boxMin.push_back(bounds.min);
+            boxMax.push_back(bounds.max);
+
+            itemEntity.push_back(index);
+            itemInstance.push_back(static_cast<uint32_t>(instance));
+        }
+    }
+    itemVisible.assign(x.size(), 0);
+
+    nodes.clear();
+    if (x.size() >= BVH_MIN_ITEMS)
+        buildTree();
+}
+
+void SceneCuller::buildTree() {
+    order.resize(x.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<uint32_t>(i);
+
+    Node root;
+    root.first = 0;
+    root.count = static_cast<uint32_t>(order.size());
+    root.left = 0;
+    nodes.push_back(root);
+    buildNode(0);
+
+    // leaves address contiguous runs of the arrays from here on
+    permute(x, order);
+    permute(y, order);
+    permute(z, order);
+    permute(radius, order);
+    permute(boxMin, order);
+    permute(boxMax, order);
+    permute(itemEntity, order);
+    permute(itemInstance, order);
+    order.clear();
+}
+
+void SceneCuller::buildNode(uint32_t node) {
+    uint32_t first = nodes[node].first, count = nodes[node].count;
+
+    glm::vec3 min = boxMin[order[first]], max = boxMax[order[first]];
+    glm::vec3 centerMin = (min + max) * 0.5f, centerMax = centerMin;
+    for (uint32_t i = first + 1; i < first + count; i++) {
+        min = glm::min(min, boxMin[order[i]]);
+        max = glm::max(max, boxMax[order[i]]);
+        glm::vec3 center = (boxMin[order[i]] + boxMax[order[i]]) * 0.5f;
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+    nodes[node].min = min;
+    nodes[node].max = max;
+    if (count <= BVH_LEAF_SIZE)
+        return;
+
+    // median split along the axis the centers spread the most
+    glm::vec3 spread = centerMax - centerMin;
+    CenterLess less = {&boxMin, &boxMax, spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2)};
+    uint32_t half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, less);
+
+    uint32_t left = static_cast<uint32_t>(nodes.size());
+    Node child;
+    child.left = 0;
+    child.first = first;
+    child.count = half;
+    nodes.push_back(child);
+    child.first = first + half;
+    child.count = count - half;
+    nodes.push_back(child);
+    nodes[node].left = left;
+
+    buildNode(left);
+    buildNode(left + 1);
+}
+
+void SceneCuller::refit(const SceneWorld &world, const std::vector<uint32_t> &indices) {
+    if (indices.empty())
+        return;
+    refitting.assign(culled.size(), 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        if (indices[i] < refitting.size())
+            refitting[indices[i]] = 1;
+    }
+
+    size_t refitted = 0;
+    for (size_t i = 0; i < itemEntity.size(); i++) {
+        // instanced entities are placed by their instance lists, not their transforms
+        uint32_t index = itemEntity[i];
+        if (!refitting[index] || world.instances[index])
+            continue;
+
+        WorldBounds bounds = transformBounds(world.meshes[index]->bounds, world.transforms[index]);
+        x[i] = bounds.center.x;
+        y[i] = bounds.center.y;
+        z[i] = bounds.center.z;
+        radius[i] = bounds.radius;
+        boxMin[i] = bounds.min;
+        boxMax[i] = bounds.max;
+        refitted++;
+    }
+
+    if (refitted && !nodes.empty())
+        refitTree();
+}
+
+void SceneCuller::refitTree() {
+    // children always come after their parent
+    for (size_t node = nodes.size(); node-- > 0;) {
+        Node &current = nodes[node];
+        if (current.left) {
+            current.min = glm::min(nodes[current.left].min, nodes[current.left + 1].min);
+            current.max = glm::max(nodes[current.left].max, nodes[current.left + 1].max);
+            continue;
+        }
+        current.min = boxMin[current.first];
+        current.max = boxMax[current.first];
+        for (uint32_t i = current.first + 1; i < current.first + current.count; i++) {
+            current.min = glm::min(current.min, boxMin[i]);
+            current.max = glm::max(current.max, boxMax[i]);
+        }
+    }
+}
+
+void SceneCuller::cull(const RenderView &view) {
+    Frustum frustum = Frustum::fromMatrix(view.projection * view.view);
+
+    std::memset(&frameStats, 0, sizeof(frameStats));
+    frameStats.tested = static_cast<unsigned int>(x.size());
+    if (nodes.empty()) {
+        frustum.testSpheres(x.data(), y.data(), z.data(), radius.data(), x.size(), itemVisible.data());
+    } else {
+        std::fill(itemVisible.begin(), itemVisible.end(), 0);
+        cullNode(frustum, 0);
+    }
+
+    for (size_t index = 0; index < instances.size(); index++)
+        instances[index].clear();
+    for (size_t i = 0; i < itemVisible.size(); i++) {
+        if (itemVisible[i] && occlusion && !occlusion->testBox(boxMin[i], boxMax[i])) {
+            itemVisible[i] = 0;
+            frameStats.occluded++;
+        }
+        if (itemVisible[i]) {
+            instances[itemEntity[i]].push_back(itemInstance[i]);
+            frameStats.visible++;
+        }
+    }
+    frameStats.culled = frameStats.tested - frameStats.visible;
+
+    report();
+}
+
+void SceneCuller::cullNode(const Frustum &frustum, uint32_t index) {
+    const Node &node = nodes[index];
+    frameStats.nodes++;
+
+    FrustumTest test = frustum.testBox(node.min, node.max);
+    if (test == FRUSTUM_OUTSIDE)
+        return;
+    if (test == FRUSTUM_INSIDE) {
+        std::fill(itemVisible.begin() + node.first, itemVisible.begin() + node.first + node.count, 1);
+        return;
+    }
+    if (node.left == 0) {
+        frustum.testSpheres(&x[node.first], &y[node.first], &z[node.first], &radius[node.first], node.count, &itemVisible[node.first]);
+        return;
+    }
+    cullNode(frustum, node.left);
+    cullNode(frustum, node.left + 1);
+}
+
+bool SceneCuller::visible(uint32_t index) const {
+    return index >= culled.size() || !culled[index] || !instances[index].empty();
+}
+
+const std::vector<uint32_t> *SceneCuller::visibleInstances(uint32_t index) const {
+    if (index >= culled.size() || !culled[index])
+        return NULL;
+    return &instances[index];
+}
+
+void SceneCuller::report() {
+    // only when something changed, like RenderQueue
+    if (std::memcmp(&frameStats, &reportedStats, sizeof(frameStats)) == 0)
+        return;
+    reportedStats = frameStats;
+
+    std::cout << label << ": " << frameStats.visible << " visible, " << frameStats.culled << " culled of " << frameStats.tested;
+    if (occlusion)
+        std::cout << ", " << frameStats.occluded << " of them occluded";
+    if (frameStats.nodes)
+        std::cout << " (" << frameStats.nodes << " BVH nodes)";
+    std::cout << std::endl;
+}
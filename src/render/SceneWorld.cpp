@@ -0,0 +1,376 @@
+#include <SceneWorld.h>
+#include <SceneCuller.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// a level is good enough while its simplification error covers at most this many pixels
+const float LOD_PIXEL_ERROR = 1.0f;
+// switch coarser only well below the threshold and finer only well above it, so a camera
+// hovering at the boundary does not flip levels every frame
+const float LOD_HYSTERESIS = 0.25f;
+
+// largest factor the matrix scales an axis by
+float axisScale(const glm::mat4 &model) {
+    return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+// worlds[targets[i]] = worlds[parents[i]] * locals[targets[i]] for one level of the hierarchy,
+// no target is another's parent. Column c of a product is the parent's columns weighted by
+// column c of the local matrix, so every column is four multiply-adds of whole columns.
+void multiplyTransforms(glm::mat4 *worlds, const glm::mat4 *locals, const uint32_t *targets, const uint32_t *parents, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        const float *parent = glm::value_ptr(worlds[parents[i]]);
+        const float *local = glm::value_ptr(locals[targets[i]]);
+        float *world = glm::value_ptr(worlds[targets[i]]);
+#endif
+#if defined(__SSE2__)
+        __m128 c0 = _mm_loadu_ps(parent), c1 = _mm_loadu_ps(parent + 4), c2 = _mm_loadu_ps(parent + 8), c3 = _mm_loadu_ps(parent + 12);
+        for (int column = 0; column < 4; column++) {
+            const float *weights = local + 4 * column;
+            __m128 result = _mm_mul_ps(c0, _mm_set1_ps(weights[0]));
+            result = _mm_add_ps(result, _mm_mul_ps(c1, _mm_set1_ps(weights[1])));
+            result = _mm_add_ps(result, _mm_mul_ps(c2, _mm_set1_ps(weights[2])));
+            result = _mm_add_ps(result, _mm_mul_ps(c3, _mm_set1_ps(weights[3])));
+            _mm_storeu_ps(world + 4 * column, result);
+        }
+#elif defined(__ARM_NEON)
+        float32x4_t c0 = vld1q_f32(parent), c1 = vld1q_f32(parent + 4), c2 = vld1q_f32(parent + 8), c3 = vld1q_f32(parent + 12);
+        for (int column = 0; column < 4; column++) {
+            const float *weights = local + 4 * column;
+            float32x4_t result = vmulq_n_f32(c0, weights[0]);
+            result = vmlaq_n_f32(result, c1, weights[1]);
+            result = vmlaq_n_f32(result, c2, weights[2]);
+            result = vmlaq_n_f32(result, c3, weights[3]);
+            vst1q_f32(world + 4 * column, result);
+        }
+#else
+        worlds[targets[i]] = worlds[parents[i]] * locals[targets[i]];
+#endif
+    }
+}
+
+}
+
+SceneWorld::SceneWorld() : anyDirty(false), orderValid(true) {}
+
+Entity SceneWorld::create() {
+    Entity entity;
+    if (!freeEntities.empty()) {
+        entity = freeEntities.back();
+        freeEntities.pop_back();
+    } else {
+        entity = static_cast<Entity>(slots.size());
+        slots.push_back(NO_ENTITY);
+    }
+    slots[entity] = static_cast<uint32_t>(entities.size());
+    entities.push_back(entity);
+
+    MaterialRef material = {std::shared_ptr<TextureAsset>(), glm::vec3(0.0f), 0.0f, -1};
+    locals.push_back(glm::mat4(1.0f));
+    parents.push_back(NO_ENTITY);
+    transforms.push_back(glm::mat4(1.0f));
+    normalMatrices.push_back(glm::mat3(1.0f));
+    meshes.push_back(std::shared_ptr<MeshAsset>());
+    instances.push_back(std::shared_ptr<InstanceBuffer>());
+    materials.push_back(material);
+    lods.push_back(0);
+    boundsX.push_back(0.0f);
+    boundsY.push_back(0.0f);
+    boundsZ.push_back(0.0f);
+    boundsRadius.push_back(std::numeric_limits<float>::infinity());
+    visible.push_back(1);
+    dirty.push_back(0);
+    orderValid = false;
+    return entity;
+}
+
+template <typename T>
+void SceneWorld::removeAt(std::vector<T> &values, uint32_t index) {
+    values[index] = values.back();
+    values.pop_back();
+}
+
+void SceneWorld::destroy(Entity entity) {
+    if (!alive(entity))
+        return;
+
+    // children stay where they are, as roots
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (parents[i] != entity)
+            continue;
+        locals[i] = transforms[i];
+        parents[i] = NO_ENTITY;
+        dirty[i] = 1;
+        anyDirty = true;
+    }
+
+    // the last entity takes over the slot, every array moves the same way
+    uint32_t index = slots[entity];
+    Entity last = entities.back();
+    removeAt(entities, index);
+    removeAt(locals, index);
+    removeAt(parents, index);
+    removeAt(transforms, index);
+    removeAt(normalMatrices, index);
+    removeAt(meshes, index);
+    removeAt(instances, index);
+    removeAt(materials, index);
+    removeAt(lods, index);
+    removeAt(boundsX, index);
+    removeAt(boundsY, index);
+    removeAt(boundsZ, index);
+    removeAt(boundsRadius, index);
+    removeAt(visible, index);
+    removeAt(dirty, index);
+
+    slots[last] = index;
+    slots[entity] = NO_ENTITY;
+    freeEntities.push_back(entity);
+    orderValid = false;
+}
+
+bool SceneWorld::ready(uint32_t index) const {
+    const MaterialRef &material = materials[index];
+    return meshes[index] && meshes[index]->ready()
+        && (material.batchIndex >= 0 || (material.texture && material.texture->ready()));
+}
+
+void SceneWorld::setTransform(uint32_t index, const glm::mat4 &local) {
+    locals[index] = local;
+    dirty[index] = 1;
+    anyDirty = true;
+}
+
+bool SceneWorld::setParent(Entity entity, Entity parent) {
+    for (Entity above = parent; above != NO_ENTITY; above = parents[slots[above]]) {
+        if (above == entity)
+            return false;
+    }
+    uint32_t index = slots[entity];
+    parents[index] = parent;
+    dirty[index] = 1;
+    anyDirty = true;
+    orderValid = false;
+    return true;
+}
+
+void SceneWorld::buildOrder() {
+    // depth by walking up to the root, hierarchies are shallow
+    std::vector<uint32_t> depths(entities.size());
+    size_t levels = entities.empty() ? 0 : 1;
+    for (size_t i = 0; i < entities.size(); i++) {
+        uint32_t depth = 0;
+        for (Entity above = parents[i]; above != NO_ENTITY; above = parents[slots[above]])
+            depth++;
+        depths[i] = depth;
+        levels = std::max(levels, static_cast<size_t>(depth) + 1);
+    }
+
+    // counting sort by depth, levelEnds first holds the counts
+    levelEnds.assign(levels, 0);
+    for (size_t i = 0; i < depths.size(); i++)
+        levelEnds[depths[i]]++;
+    std::vector<size_t> next(levels, 0);
+    for (size_t level = 1; level < levels; level++)
+        next[level] = next[level - 1] + levelEnds[level - 1];
+    order.resize(entities.size());
+    for (size_t i = 0; i < depths.size(); i++)
+        order[next[depths[i]]++] = static_cast<uint32_t>(i);
+    levelEnds.swap(next);
+    orderValid = true;
+}
+
+size_t SceneWorld::updateTransforms() {
+    moved.clear();
+    if (!anyDirty)
+        return 0;
+    if (!orderValid)
+        buildOrder();
+
+    size_t levelBegin = 0;
+    for (size_t level = 0; level < levelEnds.size(); level++) {
+        batch.clear();
+        batchParents.clear();
+        for (size_t k = levelBegin; k < levelEnds[level]; k++) {
+            uint32_t i = order[k];
+            uint32_t parent = parents[i] == NO_ENTITY ? NO_ENTITY : slots[parents[i]];
+            // the parent was settled a level up, when it moved the child moves with it
+            if (!dirty[i] && (parent == NO_ENTITY || !dirty[parent]))
+                continue;
+            dirty[i] = 1;
+            moved.push_back(i);
+            if (parent == NO_ENTITY) {
+                transforms[i] = locals[i];
+            } else {
+                batch.push_back(i);
+                batchParents.push_back(parent);
+            }
+        }
+        if (!batch.empty())
+            multiplyTransforms(&transforms[0], &locals[0], &batch[0], &batchParents[0], batch.size());
+        levelBegin = levelEnds[level];
+    }
+
+    // flags stay up until every level is done, children read their parent's
+    for (size_t k = 0; k < moved.size(); k++) {
+        uint32_t i = moved[k];
+        normalMatrices[i] = normalMatrix(transforms[i]);
+        measure(i);
+        dirty[i] = 0;
+    }
+    anyDirty = false;
+    return moved.size();
+}
+
+void SceneWorld::updateBounds() {
+    for (size_t i = 0; i < entities.size(); i++)
+        measure(i);
+}
+
+void SceneWorld::measure(size_t i) {
+    const MeshAsset *mesh = meshes[i].get();
+    if (!mesh || !mesh->ready()) {
+        // nothing to measure yet, kept visible until bounds are updated again
+        boundsX[i] = boundsY[i] = boundsZ[i] = 0.0f;
+        boundsRadius[i] = std::numeric_limits<float>::infinity();
+        return;
+    }
+
+    const InstanceBuffer *list = instances[i].get();
+    if (!list) {
+        WorldBounds bounds = transformBounds(mesh->bounds, transforms[i]);
+        boundsX[i] = bounds.center.x;
+        boundsY[i] = bounds.center.y;
+        boundsZ[i] = bounds.center.z;
+        boundsRadius[i] = bounds.radius;
+        return;
+    }
+    if (list->empty()) {
+        boundsX[i] = boundsY[i] = boundsZ[i] = 0.0f;
+        boundsRadius[i] = 0.0f;
+        return;
+    }
+
+    // a sphere around the box of the instance spheres
+    glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+    for (size_t instance = 0; instance < list->size(); instance++) {
+        WorldBounds bounds = transformBounds(mesh->bounds, list->get(instance));
+        low = glm::min(low, bounds.center - glm::vec3(bounds.radius));
+        high = glm::max(high, bounds.center + glm::vec3(bounds.radius));
+    }
+    glm::vec3 center = (low + high) * 0.5f;
+    float radius = 0.0f;
+    for (size_t instance = 0; instance < list->size(); instance++) {
+        WorldBounds bounds = transformBounds(mesh->bounds, list->get(instance));
+        radius = std::max(radius, glm::length(bounds.center - center) + bounds.radius);
+    }
+    boundsX[i] = center.x;
+    boundsY[i] = center.y;
+    boundsZ[i] = center.z;
+    boundsRadius[i] = radius;
+}
+
+void SceneWorld::instanceSphere(uint32_t index, size_t instance, glm::vec3 &center, float &radius) const {
+    const MeshBounds &bounds = meshes[index]->bounds;
+    const glm::mat4 &model = instanceModel(index, instance);
+    center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+    radius = bounds.radius * axisScale(model);
+}
+
+size_t SceneWorld::cull(const Frustum &frustum) {
+    if (entities.empty())
+        return 0;
+    frustum.testSpheres(&boundsX[0], &boundsY[0], &boundsZ[0], &boundsRadius[0], entities.size(), &visible[0]);
+
+    size_t count = 0;
+    for (size_t i = 0; i < entities.size(); i++)
+        count += visible[i];
+    return count;
+}
+
+void SceneWorld::submit(RenderQueue &queue, Shader &shader, RenderPass pass) {
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (visible[i])
+            queue.submit(*this, static_cast<uint32_t>(i), shader, pass);
+    }
+}
+
+unsigned int SceneWorld::selectLod(uint32_t index, const RenderView &view, const std::vector<uint32_t> *subset) {
+    const std::vector<MeshLod> &lods = meshes[index]->lods;
+    const MeshBounds &bounds = meshes[index]->bounds;
+    unsigned int &currentLod = this->lods[index];
+    if (lods.size() < 2)
+        return 0;
+
+    // the errors are object-space distances, the copy needing the most detail is the one
+    // with the largest scale over distance to the nearest point of its sphere
+    size_t count = subset ? subset->size() : instanceCount(index);
+    float scalePerDistance = 0.0f;
+    for (size_t k = 0; k < count; k++) {
+        const glm::mat4 &model = instanceModel(index, subset ? (*subset)[k] : k);
+        float scale = axisScale(model);
+        float distance = glm::length(glm::vec3(model * glm::vec4(bounds.center, 1.0f)) - view.position) - bounds.radius * scale;
+        if (distance <= 0.0f) {
+            currentLod = 0;
+            return currentLod;
+        }
+        scalePerDistance = std::max(scalePerDistance, scale / distance);
+    }
+
+    float pixelsPerUnit = scalePerDistance * view.pixelsPerUnit();
+    while (currentLod + 1 < lods.size() && lods[currentLod + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+        currentLod++;
+    while (currentLod > 0 && lods[currentLod].error * pixelsPerUnit > LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS))
+        currentLod--;
+    return currentLod;
+}
+
+void SceneWorld::bindMaterial(uint32_t index, Shader &shader) {
+    const MaterialRef &material = materials[index];
+    if (material.batchIndex >= 0) {
+        // texture array and material buffer are bound once for the whole batch
+        shader.setInt(UNIFORM("materialIndex"), material.batchIndex);
+    } else {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, material.texture->ID);
+
+        shader.setVec3(UNIFORM("material.specular"), material.specular);
+        shader.setFloat(UNIFORM("material.shininess"), material.shininess);
+    }
+}
+
+void SceneWorld::bindMesh(uint32_t index, Shader &shader, bool positionsOnly) {
+    bindMesh(index, shader, transforms[index], normalMatrices[index], positionsOnly);
+}
+
+void SceneWorld::bindMesh(uint32_t index, Shader &shader, const glm::mat4 &transform, const glm::mat3 &normal, bool positionsOnly) {
+    const MeshAsset &mesh = *meshes[index];
+    shader.setVec3(UNIFORM("positionOffset"), mesh.quantization.offset);
+    shader.setVec3(UNIFORM("positionScale"), mesh.quantization.scale);
+    glBindVertexArray(positionsOnly ? mesh.depthVAO : mesh.VAO);
+    if (instances[index])
+        instances[index]->bind();
+    else
+        InstanceBuffer::bindConstant(transform, normal);
+}
+
+void SceneWorld::drawLod(uint32_t index, const MeshLod &lod) {
+    const MeshAsset &mesh = *meshes[index];
+    void *offset = (void*)(lod.indexOffset * mesh.indexSize());
+    if (instances[index]) {
+        if (!instances[index]->empty())
+            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(lod.indexCount), mesh.indexType, offset, static_cast<GLsizei>(instances[index]->size()));
+        return;
+    }
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(lod.indexCount), mesh.indexType, offset);
+}
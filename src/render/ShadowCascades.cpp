@@ -0,0 +1,216 @@
+#include <ShadowCascades.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+std::string ShadowCascades::shaderDefines() {
+    std::ostringstream defines;
+    defines << "#define CASCADED_SHADOWS\n#define SHADOW_CASCADES " << SHADOW_CASCADES << "\n";
+    return defines.str();
+}
+
+ShadowCascades::ShadowCascades(float sunSpeed) : texture(0), framebuffer(0), frame(0), scheduled(0), renders(0), reportFrames(0) {
+    // a still sun has to stay above the rounding of normalize(), or its maps never stay cached
+    float angle = std::max(sunSpeed * SHADOW_LAG_SECONDS, glm::radians(0.1f));
+    cosThreshold = std::cos(std::min(angle, glm::radians(180.0f)));
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        cascades[i].view = glm::mat4(1.0f);
+        cascades[i].projection = glm::mat4(1.0f);
+        cascades[i].center = glm::vec3(0.0f);
+        cascades[i].radius = 0.0f;
+        cascades[i].direction = glm::vec3(0.0f);
+        cascades[i].renderedFrame = 0;
+        cascades[i].valid = false;
+    }
+}
+
+ShadowCascades::~ShadowCascades() {
+    if (framebuffer)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (texture)
+        glDeleteTextures(1, &texture);
+}
+
+bool ShadowCascades::init() {
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // linear filtering of a compared lookup gives 2x2 PCF for free
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        // without maps schedule() hands out nothing and bind() leaves every fragment lit
+        std::cout << "WARN: shadow map framebuffer is incomplete" << std::endl;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+        framebuffer = 0;
+        texture = 0;
+    }
+    return complete;
+}
+
+void ShadowCascades::sliceSphere(const RenderView &view, float nearDepth, float farDepth, glm::vec3 &center, float &radius) {
+    const glm::mat4 &projection = view.projection;
+    glm::vec3 corners[8];
+    glm::vec3 sum(0.0f);
+    for (int corner = 0; corner < 8; corner++) {
+        float ndcX = corner & 1 ? 1.0f : -1.0f;
+        float ndcY = corner & 2 ? 1.0f : -1.0f;
+        float depth = corner & 4 ? farDepth : nearDepth;
+        corners[corner] = glm::vec3((ndcX + projection[2][0]) * depth / projection[0][0],
+                                    (ndcY + projection[2][1]) * depth / projection[1][1], -depth);
+        sum += corners[corner];
+    }
+
+    // the centroid sits on the view axis, so the radius does not change as the camera turns
+    glm::vec3 viewCenter = sum / 8.0f;
+    radius = 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+        radius = std::max(radius, glm::length(corners[corner] - viewCenter));
+
+    // the view matrix is rigid, its inverse is the transposed rotation
+    glm::mat3 rotation(view.view);
+    center = glm::transpose(rotation) * (viewCenter - glm::vec3(view.view[3]));
+}
+
+void ShadowCascades::fit(Cascade &cascade, const glm::vec3 &center, float radius, const glm::vec3 &direction) {
+    // rounded up so the texel size only changes with the projection
+    float covered = std::ceil(radius * (1.0f + SHADOW_MARGIN) * 16.0f) / 16.0f;
+    float texel = 2.0f * covered / SHADOW_MAP_SIZE;
+
+    // light space looking down the sunlight, the center snapped to whole texels so maps of
+    // the same view and sun land on the same texels
+    glm::vec3 up = std::fabs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 rotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+    glm::vec3 lightCenter = glm::vec3(rotation * glm::vec4(center, 1.0f));
+    lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+    lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+    // the eye backs off towards the sun far enough to catch casters outside the slice
+    float back = covered + SHADOW_CASTER_DISTANCE;
+    cascade.view = glm::translate(glm::mat4(1.0f), -glm::vec3(lightCenter.x, lightCenter.y, lightCenter.z + back)) * rotation;
+    cascade.projection = glm::ortho(-covered, covered, -covered, covered, 0.0f, back + covered);
+
+    cascade.center = center;
+    cascade.radius = covered - texel;
+    cascade.direction = direction;
+    cascade.renderedFrame = frame;
+    cascade.valid = true;
+}
+
+int ShadowCascades::schedule(const RenderView &view, const glm::vec3 &lightDirection) {
+    if (!texture || scheduled >= SHADOW_UPDATES_PER_FRAME)
+        return -1;
+
+    // glm::perspective: [2][2] = -(f + n) / (f - n), [3][2] = -2fn / (f - n)
+    float nearPlane = view.projection[3][2] / (view.projection[2][2] - 1.0f);
+    float farPlane = std::min(SHADOW_DISTANCE, view.projection[3][2] / (view.projection[2][2] + 1.0f));
+    glm::vec3 direction = glm::normalize(lightDirection);
+
+    glm::vec3 centers[SHADOW_CASCADES];
+    float radii[SHADOW_CASCADES];
+    int stale = -1;
+    float sliceNear = nearPlane;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        float t = static_cast<float>(i + 1) / SHADOW_CASCADES;
+        float sliceFar = SHADOW_SPLIT_LAMBDA * nearPlane * std::pow(farPlane / nearPlane, t)
+                       + (1.0f - SHADOW_SPLIT_LAMBDA) * (nearPlane + (farPlane - nearPlane) * t);
+        sliceSphere(view, sliceNear, sliceFar, centers[i], radii[i]);
+        sliceNear = sliceFar;
+
+        // a map that no longer holds its slice is wrong now, not just old
+        Cascade &cascade = cascades[i];
+        if (!cascade.valid || glm::length(centers[i] - cascade.center) + radii[i] > cascade.radius) {
+            fit(cascade, centers[i], radii[i], direction);
+            scheduled++;
+            renders++;
+            return i;
+        }
+        if (glm::dot(cascade.direction, direction) < cosThreshold && (stale < 0 || cascade.renderedFrame < cascades[stale].renderedFrame))
+            stale = i;
+    }
+
+    if (stale >= 0) {
+        fit(cascades[stale], centers[stale], radii[stale], direction);
+        scheduled++;
+        renders++;
+    }
+    return stale;
+}
+
+void ShadowCascades::begin(int cascade) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    // slope-scaled bias against acne on surfaces facing the sun
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+}
+
+void ShadowCascades::end(int width, int height) {
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+void ShadowCascades::capture(ShadowFrame &frame) const {
+    frame.mask = 0;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        frame.views[i] = cascades[i].view;
+        frame.projections[i] = cascades[i].projection;
+        if (cascades[i].valid)
+            frame.mask |= 1 << i;
+    }
+}
+
+void ShadowCascades::bind(Shader &shader, const ShadowFrame &frame) {
+    if (!texture)
+        return;
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // clip space to texture coordinates and depth in [0, 1]
+    static const glm::mat4 bias(0.5f, 0.0f, 0.0f, 0.0f,
+                                0.0f, 0.5f, 0.0f, 0.0f,
+                                0.0f, 0.0f, 0.5f, 0.0f,
+                                0.5f, 0.5f, 0.5f, 1.0f);
+    static_assert(SHADOW_CASCADES <= 4, "name the extra shadowMatrices elements");
+    static const uint32_t matrixNames[] = {UNIFORM("shadowMatrices[0]"), UNIFORM("shadowMatrices[1]"), UNIFORM("shadowMatrices[2]"),
+                                           UNIFORM("shadowMatrices[3]")};
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        if (frame.mask & (1 << i))
+            shader.setMat4(matrixNames[i], bias * frame.projections[i] * frame.views[i]);
+    }
+    shader.setInt(UNIFORM("shadowMaps"), SHADOW_TEXTURE_UNIT);
+    shader.setInt(UNIFORM("shadowMask"), frame.mask);
+}
+
+void ShadowCascades::report() {
+    frame++;
+    scheduled = 0;
+    if (++reportFrames < SHADOW_REPORT_FRAMES)
+        return;
+
+    std::cout << "SHADOWS: " << renders << " cascade renders in " << reportFrames << " frames, "
+              << 100 * renders / (reportFrames * SHADOW_CASCADES) << "% of rendering every cascade every frame" << std::endl;
+    renders = 0;
+    reportFrames = 0;
+}
@@ -0,0 +1,262 @@
+#include "stb_image.h"
+#include <texture/Image.h>
+#include <io/FileStamp.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+LoadedImage::LoadedImage() : pixels(NULL), width(0), height(0), components(0), mapping(NULL), mappingSize(0), codec(TEXTURE_BC1) {}
+
+LoadedImage::~LoadedImage() {
+    release();
+}
+
+bool LoadedImage::load(const std::string &path) {
+    return openCache(path) || decode(path);
+}
+
+bool LoadedImage::decode(const std::string &path) {
+    release();
+    pixels = stbi_load(path.c_str(), &width, &height, &components, 0);
+    if (!pixels) {
+        std::cout << "Failed to load texture: " << path << std::endl;
+        width = height = components = 0;
+        return false;
+    }
+    return true;
+}
+
+bool LoadedImage::openCache(const std::string &path) {
+    release();
+
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if (!fileStamp(path, sourceSize, sourceMtime))
+        return false;
+
+    std::string cachePath = textureCachePath(path);
+    int fd = open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TextureCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    TextureCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    // a full chain ends at 1x1, floor(log2(largest side)) + 1 levels
+    uint32_t chainLength = 1;
+    for (uint32_t side = std::max(header.width, header.height); side > 1; side >>= 1)
+        chainLength++;
+
+    bool valid = std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) == 0
+        && header.version == TEXTURE_CACHE_VERSION
+        && header.sourceSize == sourceSize
+        && header.sourceMtime == sourceMtime
+        && (header.codec == TEXTURE_BC1 || header.codec == TEXTURE_BC3)
+        && header.width > 0 && header.width <= TEXTURE_CACHE_MAX_SIZE
+        && header.height > 0 && header.height <= TEXTURE_CACHE_MAX_SIZE
+        && header.levelCount > 0 && header.levelCount <= chainLength
+        && sizeof(TextureCacheHeader) + header.levelCount * sizeof(TextureCacheLevel) <= size;
+
+    // the streamer copies what the table promises, so every level has to be the size its
+    // place in the chain implies and lie inside the file, checked without overflowing
+    if (valid) {
+        cookedLevels.resize(header.levelCount);
+        std::memcpy(&cookedLevels[0], static_cast<const char *>(data) + sizeof(TextureCacheHeader),
+                    header.levelCount * sizeof(TextureCacheLevel));
+        TextureCodec levelCodec = static_cast<TextureCodec>(header.codec);
+        for (uint32_t i = 0; i < header.levelCount && valid; i++) {
+            const TextureCacheLevel &level = cookedLevels[i];
+            valid = level.width == std::max(1u, header.width >> i)
+                && level.height == std::max(1u, header.height >> i)
+                && level.bytes == levelBytes(levelCodec, level.width, level.height)
+                && level.offset <= size
+                && level.bytes <= size - level.offset;
+        }
+    }
+
+    if (!valid) {
+        cookedLevels.clear();
+        munmap(data, size);
+        return false;
+    }
+
+    mapping = data;
+    mappingSize = size;
+    codec = static_cast<TextureCodec>(header.codec);
+    width = static_cast<int>(header.width);
+    height = static_cast<int>(header.height);
+    components = codec == TEXTURE_BC1 ? 3 : 4;
+    pixels = static_cast<unsigned char *>(data) + cookedLevels[0].offset;
+    return true;
+}
+
+void LoadedImage::resample(int newWidth, int newHeight) {
+    if (!pixels || mapping)
+        return;
+
+    std::vector<unsigned char> resized(static_cast<size_t>(newWidth) * newHeight * 4);
+    float scaleX = static_cast<float>(width) / newWidth;
+    float scaleY = static_cast<float>(height) / newHeight;
+    unsigned char *dst = resized.data();
+    for (int y = 0; y < newHeight; y++) {
+        // sample at texel centers, clamped to the edge
+        float sy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), static_cast<float>(height - 1));
+        int y0 = static_cast<int>(sy), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < newWidth; x++) {
+            float sx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), static_cast<float>(width - 1));
+            int x0 = static_cast<int>(sx), x1 = std::min(x0 + 1, width - 1);
+            float fx = sx - x0;
+
+            const unsigned char *t00 = pixels + (static_cast<size_t>(y0) * width + x0) * components;
+            const unsigned char *t10 = pixels + (static_cast<size_t>(y0) * width + x1) * components;
+            const unsigned char *t01 = pixels + (static_cast<size_t>(y1) * width + x0) * components;
+            const unsigned char *t11 = pixels + (static_cast<size_t>(y1) * width + x1) * components;
+            float texel[4];
+            for (int c = 0; c < components; c++) {
+                float top = t00[c] + (t10[c] - t00[c]) * fx;
+                float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+                texel[c] = top + (bottom - top) * fy;
+            }
+
+            // grey and grey+alpha spread over RGB, missing alpha is opaque
+            if (components <= 2) {
+                texel[3] = components == 2 ? texel[1] : 255.0f;
+                texel[1] = texel[2] = texel[0];
+            } else if (components == 3) {
+                texel[3] = 255.0f;
+            }
+            for (int c = 0; c < 4; c++)
+                *dst++ = static_cast<unsigned char>(texel[c] + 0.5f);
+        }
+    }
+
+    release();
+    ownedPixels.swap(resized);
+    pixels = ownedPixels.data();
+    width = newWidth;
+    height = newHeight;
+    components = 4;
+}
+
+void LoadedImage::buildMipChain() {
+    mipPixels.clear();
+    mipOffsets.clear();
+    // cooked textures come with their levels
+    if (!pixels || mapping)
+        return;
+
+    size_t total = 0;
+    for (int w = width, h = height; w > 1 || h > 1;) {
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+        mipOffsets.push_back(total);
+        total += static_cast<size_t>(w) * h * components;
+    }
+    mipPixels.resize(total);
+
+    const unsigned char *src = pixels;
+    int srcWidth = width, srcHeight = height;
+    for (size_t i = 0; i < mipOffsets.size(); i++) {
+        int w = std::max(1, srcWidth / 2);
+        int h = std::max(1, srcHeight / 2);
+        unsigned char *dst = &mipPixels[mipOffsets[i]];
+
+        // 2x2 box filter, odd edges reuse the last row/column
+        for (int y = 0; y < h; y++) {
+            const unsigned char *row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * components;
+            const unsigned char *row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * components;
+            for (int x = 0; x < w; x++) {
+                int x0 = std::min(2 * x, srcWidth - 1) * components;
+                int x1 = std::min(2 * x + 1, srcWidth - 1) * components;
+                for (int c = 0; c < components; c++)
+                    *dst++ = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+
+        src = &mipPixels[mipOffsets[i]];
+        srcWidth = w;
+        srcHeight = h;
+    }
+}
+
+unsigned int LoadedImage::levelCount() const {
+    if (!pixels)
+        return 0;
+    if (mapping)
+        return static_cast<unsigned int>(cookedLevels.size());
+    return 1 + static_cast<unsigned int>(mipOffsets.size());
+}
+
+ImageLevel LoadedImage::level(unsigned int index) const {
+    ImageLevel result;
+    result.width = std::max(1, width >> index);
+    result.height = std::max(1, height >> index);
+
+    if (mapping) {
+        result.data = static_cast<const unsigned char *>(mapping) + cookedLevels[index].offset;
+        // openCache() checked bytes against the mapping, the rows are taken from it
+        result.bytes = static_cast<size_t>(cookedLevels[index].bytes);
+        result.rowBytes = static_cast<size_t>((result.width + 3) / 4) * blockBytes(codec);
+        result.rows = static_cast<int>(result.bytes / result.rowBytes);
+        return result;
+    }
+
+    result.bytes = static_cast<size_t>(result.width) * result.height * components;
+    result.data = index == 0 ? pixels : &mipPixels[mipOffsets[index - 1]];
+    result.rows = result.height;
+    result.rowBytes = static_cast<size_t>(result.width) * components;
+    return result;
+}
+
+size_t LoadedImage::totalBytes() const {
+    if (!pixels)
+        return 0;
+    if (mapping)
+        return mappingSize;
+    return level(0).bytes + mipPixels.size();
+}
+
+GLenum LoadedImage::internalFormat() const {
+    return mapping ? compressedFormat(codec) : format();
+}
+
+void LoadedImage::release() {
+    if (mapping)
+        munmap(mapping, mappingSize);
+    else if (pixels && ownedPixels.empty())
+        stbi_image_free(pixels);
+    std::vector<unsigned char>().swap(ownedPixels);
+    pixels = NULL;
+    mapping = NULL;
+    mappingSize = 0;
+    cookedLevels.clear();
+    std::vector<unsigned char>().swap(mipPixels);
+    mipOffsets.clear();
+}
+
+GLenum LoadedImage::format() const {
+    if (components == 1)
+        return GL_RED;
+    else if (components == 2)
+        return GL_RG;
+    else if (components == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
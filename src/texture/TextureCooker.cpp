@@ -0,0 +1,446 @@
+#include <texture/TextureCooker.h>
+#include <async/ThreadPool.h>
+#include <io/FileStamp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// block rows handed to one pool task
+const int BLOCK_ROWS_PER_TASK = 8;
+const int POWER_ITERATIONS = 4;
+
+// palette position (in thirds from color 0 to color 1) to BC1 index
+const unsigned int BC1_INDEX[4] = {0, 2, 3, 1};
+// weight of color 0 for each BC1 index in 4-color mode
+const float BC1_WEIGHT[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+struct ColorBlock {
+  float r[16], g[16], b[16];
+};
+
+struct ColorFit {
+  unsigned short color0, color1;
+  unsigned int indices;
+  float error;
+};
+
+unsigned short packColor565(const float c[3]) {
+  int r = std::min(31, std::max(0, static_cast<int>(c[0] * (31.0f / 255.0f) + 0.5f)));
+  int g = std::min(63, std::max(0, static_cast<int>(c[1] * (63.0f / 255.0f) + 0.5f)));
+  int b = std::min(31, std::max(0, static_cast<int>(c[2] * (31.0f / 255.0f) + 0.5f)));
+  return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+}
+
+void unpackColor565(unsigned short color, float c[3]) {
+  int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  c[0] = static_cast<float>((r << 3) | (r >> 2));
+  c[1] = static_cast<float>((g << 2) | (g >> 4));
+  c[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// out[i] = dot(texel[i] - origin, axis) for the 16 texels of the block
+void projectTexels(const ColorBlock &block, const float origin[3], const float axis[3], float *out) {
+#if defined(__SSE2__)
+  __m128 ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+  __m128 ax = _mm_set1_ps(axis[0]), ay = _mm_set1_ps(axis[1]), az = _mm_set1_ps(axis[2]);
+  for (int i = 0; i < 16; i += 4) {
+    __m128 dot = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.r + i), ox), ax);
+    dot = _mm_add_ps(dot, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.g + i), oy), ay));
+    dot = _mm_add_ps(dot, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(block.b + i), oz), az));
+    _mm_storeu_ps(out + i, dot);
+  }
+#elif defined(__ARM_NEON)
+  float32x4_t ox = vdupq_n_f32(origin[0]), oy = vdupq_n_f32(origin[1]), oz = vdupq_n_f32(origin[2]);
+  float32x4_t ax = vdupq_n_f32(axis[0]), ay = vdupq_n_f32(axis[1]), az = vdupq_n_f32(axis[2]);
+  for (int i = 0; i < 16; i += 4) {
+    float32x4_t dot = vmulq_f32(vsubq_f32(vld1q_f32(block.r + i), ox), ax);
+    dot = vaddq_f32(dot, vmulq_f32(vsubq_f32(vld1q_f32(block.g + i), oy), ay));
+    dot = vaddq_f32(dot, vmulq_f32(vsubq_f32(vld1q_f32(block.b + i), oz), az));
+    vst1q_f32(out + i, dot);
+  }
+#else
+  for (int i = 0; i < 16; i++)
+    out[i] = (block.r[i] - origin[0]) * axis[0] + (block.g[i] - origin[1]) * axis[1] + (block.b[i] - origin[2]) * axis[2];
+#endif
+}
+
+float texelError(const ColorBlock &block, int i, const float c[3]) {
+  float dr = block.r[i] - c[0], dg = block.g[i] - c[1], db = block.b[i] - c[2];
+  return dr * dr + dg * dg + db * db;
+}
+
+// quantizes the endpoints and picks the nearest of the 4 palette entries along the line
+ColorFit fitEndpoints(const ColorBlock &block, const float end0[3], const float end1[3]) {
+  ColorFit fit;
+  fit.color0 = packColor565(end0);
+  fit.color1 = packColor565(end1);
+  fit.indices = 0;
+  fit.error = 0.0f;
+  // 4-color mode needs color0 > color1, swapping the endpoints swaps the indices too
+  if (fit.color0 < fit.color1)
+    std::swap(fit.color0, fit.color1);
+
+  float palette[4][3];
+  unpackColor565(fit.color0, palette[0]);
+  unpackColor565(fit.color1, palette[1]);
+
+  if (fit.color0 == fit.color1) {
+    for (int i = 0; i < 16; i++)
+      fit.error += texelError(block, i, palette[0]);
+    return fit;
+  }
+
+  for (int c = 0; c < 3; c++) {
+    palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+    palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+  }
+
+  float axis[3] = {palette[1][0] - palette[0][0], palette[1][1] - palette[0][1], palette[1][2] - palette[0][2]};
+  float scale = 3.0f / (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  for (int c = 0; c < 3; c++)
+    axis[c] *= scale;
+
+  float t[16];
+  projectTexels(block, palette[0], axis, t);
+  for (int i = 0; i < 16; i++) {
+    int step = static_cast<int>(std::min(3.0f, std::max(0.0f, t[i])) + 0.5f);
+    unsigned int index = BC1_INDEX[step];
+    fit.indices |= index << (2 * i);
+    fit.error += texelError(block, i, palette[index]);
+  }
+  return fit;
+}
+
+// least squares endpoints for the palette assignment of fit
+bool refineEndpoints(const ColorBlock &block, const ColorFit &fit, float end0[3], float end1[3]) {
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  float ap[3] = {0.0f, 0.0f, 0.0f}, bp[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; i++) {
+    float a = BC1_WEIGHT[(fit.indices >> (2 * i)) & 3], b = 1.0f - a;
+    float texel[3] = {block.r[i], block.g[i], block.b[i]};
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (int c = 0; c < 3; c++) {
+      ap[c] += a * texel[c];
+      bp[c] += b * texel[c];
+    }
+  }
+
+  float det = aa * bb - ab * ab;
+  if (std::fabs(det) < 1e-6f)
+    return false;
+  for (int c = 0; c < 3; c++) {
+    end0[c] = (ap[c] * bb - bp[c] * ab) / det;
+    end1[c] = (bp[c] * aa - ap[c] * ab) / det;
+  }
+  return true;
+}
+
+void writeColorBlock(const ColorFit &fit, unsigned char *out) {
+  out[0] = static_cast<unsigned char>(fit.color0 & 0xff);
+  out[1] = static_cast<unsigned char>(fit.color0 >> 8);
+  out[2] = static_cast<unsigned char>(fit.color1 & 0xff);
+  out[3] = static_cast<unsigned char>(fit.color1 >> 8);
+  for (int i = 0; i < 4; i++)
+    out[4 + i] = static_cast<unsigned char>(fit.indices >> (8 * i));
+}
+
+void encodeColor(const unsigned char *rgba, unsigned char *out) {
+  ColorBlock block;
+  float mean[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; i++) {
+    block.r[i] = rgba[4 * i + 0];
+    block.g[i] = rgba[4 * i + 1];
+    block.b[i] = rgba[4 * i + 2];
+    mean[0] += block.r[i];
+    mean[1] += block.g[i];
+    mean[2] += block.b[i];
+  }
+  for (int c = 0; c < 3; c++)
+    mean[c] /= 16.0f;
+
+  // principal axis of the block's colors by power iteration on the covariance
+  float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; i++) {
+    float r = block.r[i] - mean[0], g = block.g[i] - mean[1], b = block.b[i] - mean[2];
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  }
+
+  // start from the covariance column of the channel with the most variance, a fixed start
+  // vector can be orthogonal to the axis (e.g. red rising while green falls)
+  float axis[3] = {cov[0], cov[1], cov[2]};
+  if (cov[3] > cov[0] && cov[3] >= cov[5]) {
+    axis[0] = cov[1];
+    axis[1] = cov[3];
+    axis[2] = cov[4];
+  } else if (cov[5] > cov[0] && cov[5] > cov[3]) {
+    axis[0] = cov[2];
+    axis[1] = cov[4];
+    axis[2] = cov[5];
+  }
+  for (int i = 0; i < POWER_ITERATIONS; i++) {
+    float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+    float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+    float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+    float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+    if (length < 1e-6f) {
+      x = y = z = 0.0f;
+      length = 1.0f;
+    }
+    axis[0] = x / length;
+    axis[1] = y / length;
+    axis[2] = z / length;
+  }
+  float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (length > 0.0f) {
+    for (int c = 0; c < 3; c++)
+      axis[c] /= length;
+  }
+
+  float t[16];
+  projectTexels(block, mean, axis, t);
+  float tMin = *std::min_element(t, t + 16), tMax = *std::max_element(t, t + 16);
+
+  float end0[3], end1[3];
+  for (int c = 0; c < 3; c++) {
+    end0[c] = mean[c] + axis[c] * tMax;
+    end1[c] = mean[c] + axis[c] * tMin;
+  }
+
+  ColorFit best = fitEndpoints(block, end0, end1);
+  if (best.error > 0.0f && best.color0 != best.color1 && refineEndpoints(block, best, end0, end1)) {
+    ColorFit refined = fitEndpoints(block, end0, end1);
+    if (refined.error < best.error)
+      best = refined;
+  }
+  writeColorBlock(best, out);
+}
+
+void encodeAlpha(const unsigned char *rgba, unsigned char *out) {
+  int alphaMin = 255, alphaMax = 0;
+  for (int i = 0; i < 16; i++) {
+    alphaMin = std::min(alphaMin, static_cast<int>(rgba[4 * i + 3]));
+    alphaMax = std::max(alphaMax, static_cast<int>(rgba[4 * i + 3]));
+  }
+
+  // alpha0 > alpha1 selects the 8 value ramp, index 0 is alpha0, 1 is alpha1 and 2..7 step
+  // from alpha0 towards alpha1
+  out[0] = static_cast<unsigned char>(alphaMax);
+  out[1] = static_cast<unsigned char>(alphaMin);
+  unsigned long long indices = 0;
+  if (alphaMax > alphaMin) {
+    float scale = 7.0f / (alphaMax - alphaMin);
+    for (int i = 0; i < 16; i++) {
+      int step = static_cast<int>((rgba[4 * i + 3] - alphaMin) * scale + 0.5f);
+      unsigned long long index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+      indices |= index << (3 * i);
+    }
+  }
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+}
+
+// gathers the 4x4 block at (bx, by) as RGBA, edge blocks repeat the last row/column
+void loadBlock(const ImageLevel &level, int components, int bx, int by, unsigned char *rgba) {
+  for (int y = 0; y < 4; y++) {
+    int sy = std::min(by * 4 + y, level.height - 1);
+    for (int x = 0; x < 4; x++) {
+      int sx = std::min(bx * 4 + x, level.width - 1);
+      const unsigned char *texel = level.data + (static_cast<size_t>(sy) * level.width + sx) * components;
+      unsigned char *dst = rgba + 4 * (y * 4 + x);
+      if (components <= 2) {
+        dst[0] = dst[1] = dst[2] = texel[0];
+        dst[3] = components == 2 ? texel[1] : 255;
+      } else {
+        dst[0] = texel[0];
+        dst[1] = texel[1];
+        dst[2] = texel[2];
+        dst[3] = components == 4 ? texel[3] : 255;
+      }
+    }
+  }
+}
+
+void compressRows(const ImageLevel &level, int components, TextureCodec codec, int firstRow, int lastRow, unsigned char *out) {
+  int blocksWide = (level.width + 3) / 4;
+  size_t bytes = blockBytes(codec);
+  unsigned char rgba[64];
+  for (int by = firstRow; by < lastRow; by++) {
+    for (int bx = 0; bx < blocksWide; bx++) {
+      loadBlock(level, components, bx, by, rgba);
+      unsigned char *block = out + (static_cast<size_t>(by) * blocksWide + bx) * bytes;
+      if (codec == TEXTURE_BC1)
+        encodeBC1Block(rgba, block);
+      else
+        encodeBC3Block(rgba, block);
+    }
+  }
+}
+
+double levelError(const ImageLevel &level, int components, TextureCodec codec, const std::vector<unsigned char> &blocks) {
+  int blocksWide = (level.width + 3) / 4;
+  int blocksHigh = (level.height + 3) / 4;
+  size_t bytes = blockBytes(codec);
+  double sum = 0.0;
+  unsigned char source[64], decoded[64];
+  for (int by = 0; by < blocksHigh; by++) {
+    for (int bx = 0; bx < blocksWide; bx++) {
+      loadBlock(level, components, bx, by, source);
+      const unsigned char *block = &blocks[(static_cast<size_t>(by) * blocksWide + bx) * bytes];
+      decodeBC1Block(codec == TEXTURE_BC1 ? block : block + 8, decoded);
+      for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+          double d = static_cast<double>(source[4 * i + c]) - decoded[4 * i + c];
+          sum += d * d;
+        }
+      }
+    }
+  }
+  return std::sqrt(sum / (16.0 * 3.0 * blocksWide * blocksHigh));
+}
+
+}
+
+void encodeBC1Block(const unsigned char *rgba, unsigned char *out) {
+  encodeColor(rgba, out);
+}
+
+void encodeBC3Block(const unsigned char *rgba, unsigned char *out) {
+  encodeAlpha(rgba, out);
+  encodeColor(rgba, out + 8);
+}
+
+void decodeBC1Block(const unsigned char *block, unsigned char *rgba) {
+  unsigned short color0 = static_cast<unsigned short>(block[0] | (block[1] << 8));
+  unsigned short color1 = static_cast<unsigned short>(block[2] | (block[3] << 8));
+  float palette[4][3];
+  unpackColor565(color0, palette[0]);
+  unpackColor565(color1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    if (color0 > color1) {
+      palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+      palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+      palette[3][c] = 0.0f;
+    }
+  }
+
+  unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<unsigned int>(block[7]) << 24);
+  for (int i = 0; i < 16; i++) {
+    unsigned int index = (indices >> (2 * i)) & 3;
+    for (int c = 0; c < 3; c++)
+      rgba[4 * i + c] = static_cast<unsigned char>(palette[index][c] + 0.5f);
+    rgba[4 * i + 3] = color0 <= color1 && index == 3 ? 0 : 255;
+  }
+}
+
+std::vector<unsigned char> compressLevel(const ImageLevel &level, int components, TextureCodec codec, ThreadPool *pool) {
+  int blocksWide = (level.width + 3) / 4;
+  int blocksHigh = (level.height + 3) / 4;
+  std::vector<unsigned char> blocks(static_cast<size_t>(blocksWide) * blocksHigh * blockBytes(codec));
+
+  if (!pool || blocksHigh <= BLOCK_ROWS_PER_TASK) {
+    compressRows(level, components, codec, 0, blocksHigh, blocks.data());
+    return blocks;
+  }
+
+  std::mutex mutex;
+  std::condition_variable done;
+  int remaining = (blocksHigh + BLOCK_ROWS_PER_TASK - 1) / BLOCK_ROWS_PER_TASK;
+  unsigned char *out = blocks.data();
+  for (int row = 0; row < blocksHigh; row += BLOCK_ROWS_PER_TASK) {
+    int last = std::min(blocksHigh, row + BLOCK_ROWS_PER_TASK);
+    pool->submit([&, row, last]() {
+      compressRows(level, components, codec, row, last, out);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--remaining == 0)
+        done.notify_one();
+    });
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (remaining > 0)
+    done.wait(lock);
+  return blocks;
+}
+
+bool cookTexture(const std::string &imagePath, ThreadPool *pool, TextureCookStats *stats) {
+  LoadedImage image;
+  if (!image.decode(imagePath))
+    return false;
+  image.buildMipChain();
+
+  TextureCodec codec = image.components == 2 || image.components == 4 ? TEXTURE_BC3 : TEXTURE_BC1;
+
+  TextureCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+  header.version = TEXTURE_CACHE_VERSION;
+  if (!fileStamp(imagePath, header.sourceSize, header.sourceMtime))
+    return false;
+  header.codec = codec;
+  header.width = static_cast<uint32_t>(image.width);
+  header.height = static_cast<uint32_t>(image.height);
+  header.levelCount = image.levelCount();
+
+  std::vector<TextureCacheLevel> table(header.levelCount);
+  std::vector<std::vector<unsigned char> > levels(header.levelCount);
+  uint64_t offset = sizeof(TextureCacheHeader) + header.levelCount * sizeof(TextureCacheLevel);
+  for (unsigned int i = 0; i < header.levelCount; i++) {
+    ImageLevel level = image.level(i);
+    levels[i] = compressLevel(level, image.components, codec, pool);
+    table[i].width = static_cast<uint32_t>(level.width);
+    table[i].height = static_cast<uint32_t>(level.height);
+    table[i].offset = offset;
+    table[i].bytes = levels[i].size();
+    offset += levels[i].size();
+  }
+
+  if (stats) {
+    stats->sourceBytes = image.totalBytes();
+    stats->cookedBytes = static_cast<size_t>(offset - table[0].offset);
+    stats->rmse = levelError(image.level(0), image.components, codec, levels[0]);
+  }
+
+  // write next to the final name and rename so readers never see a partial file
+  std::string path = textureCachePath(imagePath);
+  std::string tmpPath = path + ".tmp";
+  FILE *file = std::fopen(tmpPath.c_str(), "wb");
+  if (!file) {
+    std::cout << "WARN: cannot write texture cache " << path << std::endl;
+    return false;
+  }
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok)
+    ok = std::fwrite(table.data(), sizeof(TextureCacheLevel), table.size(), file) == table.size();
+  for (size_t i = 0; ok && i < levels.size(); i++)
+    ok = std::fwrite(levels[i].data(), 1, levels[i].size(), file) == levels[i].size();
+  ok = std::fclose(file) == 0 && ok;
+
+  if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    std::remove(tmpPath.c_str());
+    std::cout << "WARN: cannot write texture cache " << path << std::endl;
+    return false;
+  }
+  return true;
+}
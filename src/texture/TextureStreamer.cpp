@@ -0,0 +1,138 @@
+#include <texture/TextureStreamer.h>
+#include <assets/TextureAsset.h>
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer::TextureStreamer(size_t budget) : bufferSize(std::max(budget, MIN_UPLOAD_BUDGET)), current(0) {
+  streamStats.bytes = 0;
+  streamStats.levels = 0;
+  streamStats.stalls = 0;
+
+  // the staging buffers are created on first use, the loader can exist before the GL context
+  for (unsigned int i = 0; i < STREAM_BUFFER_COUNT; i++) {
+    buffers[i] = 0;
+    fences[i] = 0;
+  }
+}
+
+TextureStreamer::~TextureStreamer() {
+  for (unsigned int i = 0; i < STREAM_BUFFER_COUNT; i++) {
+    if (fences[i])
+      glDeleteSync(fences[i]);
+    if (buffers[i])
+      glDeleteBuffers(1, &buffers[i]);
+  }
+}
+
+void TextureStreamer::stream(const std::shared_ptr<TextureAsset> &texture, const std::shared_ptr<LoadedImage> &image,
+                             const std::function<void()> &done) {
+  int resident = texture->allocate(*image, PLACEHOLDER_SIZE);
+  if (resident == 0) {
+    image->release();
+    if (done)
+      done();
+    return;
+  }
+
+  std::shared_ptr<Upload> upload = std::make_shared<Upload>();
+  upload->texture = texture;
+  upload->image = image;
+  upload->done = done;
+  upload->level = resident - 1;
+  upload->row = 0;
+  uploads.push_back(upload);
+}
+
+void TextureStreamer::update() {
+  if (uploads.empty())
+    return;
+
+  if (!buffers[current]) {
+    glGenBuffers(1, &buffers[current]);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, NULL, GL_STREAM_DRAW);
+  }
+
+  if (fences[current]) {
+    // never wait here, a busy buffer just means this frame uploads nothing
+    if (glClientWaitSync(fences[current], 0, 0) == GL_TIMEOUT_EXPIRED) {
+      streamStats.stalls++;
+      return;
+    }
+    glDeleteSync(fences[current]);
+    fences[current] = 0;
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+  unsigned char *staging = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+  if (!staging) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return;
+  }
+
+  // copy whole rows until the budget is used up, large levels span several frames
+  regions.clear();
+  size_t used = 0;
+  while (!uploads.empty()) {
+    std::shared_ptr<Upload> upload = uploads.front();
+    ImageLevel level = upload->image->level(upload->level);
+    size_t rowBytes = level.rowBytes;
+    int rows = std::min(level.rows - upload->row, static_cast<int>((bufferSize - used) / rowBytes));
+    if (rows == 0)
+      break;
+
+    memcpy(staging + used, level.data + upload->row * rowBytes, rows * rowBytes);
+    Region region = {upload, upload->level, upload->row, rows, used};
+    regions.push_back(region);
+    used += rows * rowBytes;
+
+    upload->row += rows;
+    if (upload->row == level.rows) {
+      upload->level--;
+      upload->row = 0;
+      if (upload->level < 0)
+        uploads.pop_front();
+    }
+  }
+
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < regions.size(); i++) {
+    const Region &region = regions[i];
+    TextureAsset &texture = *region.upload->texture;
+    LoadedImage &image = *region.upload->image;
+    ImageLevel level = image.level(region.level);
+
+    size_t bytes = level.rowBytes * region.rows;
+
+    glBindTexture(GL_TEXTURE_2D, texture.ID);
+    if (image.compressed()) {
+      // rows are 4 texel high blocks, the last one may cover less of the level
+      int y = region.row * 4;
+      int height = std::min(region.rows * 4, level.height - y);
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, region.level, 0, y, level.width, height, image.internalFormat(),
+                                static_cast<GLsizei>(bytes), (void*)region.offset);
+    } else {
+      glTexSubImage2D(GL_TEXTURE_2D, region.level, 0, region.row, level.width, region.rows, image.format(),
+                      GL_UNSIGNED_BYTE, (void*)region.offset);
+    }
+    streamStats.bytes += bytes;
+
+    if (region.row + region.rows == level.rows) {
+      texture.setBaseLevel(region.level);
+      streamStats.levels++;
+      if (region.level == 0) {
+        image.release();
+        if (region.upload->done)
+          region.upload->done();
+      }
+    }
+  }
+  regions.clear();
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  current = (current + 1) % STREAM_BUFFER_COUNT;
+}
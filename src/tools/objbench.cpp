@@ -0,0 +1,83 @@
+// Compares OBJ parsing throughput of tinyobjloader against the mmap parser used by the loader.
+// usage: luna_objbench [file.obj ...]   (defaults to the bundled models)
+#include <mesh/ObjParser.h>
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int ITERATIONS = 20;
+
+// the flattening RenderObject::loadObjModel used to do on top of tinyobj::LoadObj
+bool loadWithTinyObj(const std::string &path, std::vector<float> &vertices) {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+    return false;
+
+  vertices.clear();
+  for (const auto &shape : shapes) {
+    for (const auto &index : shape.mesh.indices) {
+      vertices.push_back(attrib.vertices[3 * index.vertex_index + 0]);
+      vertices.push_back(attrib.vertices[3 * index.vertex_index + 1]);
+      vertices.push_back(attrib.vertices[3 * index.vertex_index + 2]);
+      for (int i = 0; i < 3; i++)
+        vertices.push_back(index.normal_index >= 0 ? attrib.normals[3 * index.normal_index + i] : 0.0f);
+      for (int i = 0; i < 2; i++)
+        vertices.push_back(index.texcoord_index >= 0 ? attrib.texcoords[2 * index.texcoord_index + i] : 0.0f);
+    }
+  }
+  return true;
+}
+
+template <typename Fn>
+double bestSeconds(Fn fn) {
+  double best = 1e30;
+  for (int i = 0; i < ITERATIONS; i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds < best)
+      best = seconds;
+  }
+  return best;
+}
+
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++)
+    paths.push_back(argv[i]);
+  if (paths.empty()) {
+    const char *models[] = {"bridge", "dirt", "grass", "leaves", "stone", "sun", "water", "wood"};
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+      paths.push_back(std::string(LUNA_RESOURCE_DIR) + "/models/" + models[i] + ".obj");
+  }
+
+  std::printf("%-48s %10s %14s %14s %8s\n", "file", "KB", "tinyobj MB/s", "parser MB/s", "speedup");
+  for (size_t i = 0; i < paths.size(); i++) {
+    std::vector<float> reference, parsed;
+    ObjParseStats stats;
+    if (!loadWithTinyObj(paths[i], reference) || !parseObj(paths[i], parsed, 0, &stats)) {
+      std::printf("%-48s failed to load\n", paths[i].c_str());
+      continue;
+    }
+    if (reference.size() != parsed.size())
+      std::printf("%-48s WARN: %zu vs %zu floats\n", paths[i].c_str(), reference.size(), parsed.size());
+
+    double tiny = bestSeconds([&]() { loadWithTinyObj(paths[i], reference); });
+    double fast = bestSeconds([&]() { parseObj(paths[i], parsed); });
+    double megabytes = stats.bytes / (1024.0 * 1024.0);
+
+    std::printf("%-48s %10.1f %14.1f %14.1f %7.1fx\n", paths[i].c_str(), stats.bytes / 1024.0,
+                megabytes / tiny, megabytes / fast, tiny / fast);
+  }
+  return 0;
+}
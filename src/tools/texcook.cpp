@@ -0,0 +1,40 @@
+// Cooks images into S3TC mip chains (<image>.ltex) that LoadedImage::load picks up instead of
+// decoding the source.
+// usage: luna_texcook [image ...]   (defaults to the bundled textures)
+#include <texture/TextureCooker.h>
+#include <async/ThreadPool.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++)
+    paths.push_back(argv[i]);
+  if (paths.empty()) {
+    const char *textures[] = {"dirt.jpg", "grass.jpg", "leaves.jpg", "luna.jpeg", "stone.jpg", "water.jpeg", "wood.jpeg"};
+    for (size_t i = 0; i < sizeof(textures) / sizeof(textures[0]); i++)
+      paths.push_back(std::string(LUNA_RESOURCE_DIR) + "/textures/" + textures[i]);
+  }
+
+  ThreadPool pool;
+  int failed = 0;
+  std::printf("%-48s %12s %12s %7s %7s %9s\n", "file", "raw KB", "cooked KB", "ratio", "rmse", "ms");
+  for (size_t i = 0; i < paths.size(); i++) {
+    TextureCookStats stats;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!cookTexture(paths[i], &pool, &stats)) {
+      std::printf("%-48s failed to cook\n", paths[i].c_str());
+      failed++;
+      continue;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-48s %12.1f %12.1f %6.1fx %7.2f %9.1f\n", paths[i].c_str(), stats.sourceBytes / 1024.0,
+                stats.cookedBytes / 1024.0, static_cast<double>(stats.sourceBytes) / stats.cookedBytes, stats.rmse, ms);
+  }
+  std::printf("%u threads\n", pool.size());
+  return failed ? 1 : 0;
+}